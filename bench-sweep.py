@@ -0,0 +1,159 @@
+import json
+import logging
+import os
+import shlex
+import subprocess
+import sys
+
+log = logging.getLogger("bench-sweep")
+logging.basicConfig(format='%(asctime)s [%(levelname)s] :: %(message)s', datefmt='%m/%d/%Y %I:%M:%S %p',
+                    level=logging.INFO)
+
+
+def run_sweep(args, ranks, output_dir):
+    """Run the --bench-sweep driver mode on the given number of ranks and return its JSON report."""
+    output = os.path.join(output_dir, f"bench.{ranks}.json")
+    command = shlex.split(args.mpirun) + ["-n", str(ranks), args.exe,
+                                          "--file", args.deck,
+                                          "--bench-sweep", args.sizes,
+                                          "--bench-scaling", args.scaling,
+                                          "--bench-iterations", str(args.iterations),
+                                          "--bench-output", output]
+    log.info(f"Running {' '.join(command)}")
+    subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+    with open(output, 'r') as report:
+        return json.load(report)
+
+
+def case_key(case):
+    return f"{case['ranks']}:{case['x_cells']}x{case['y_cells']}"
+
+
+def compare(results, baseline, tolerance, kernel_tolerance, kernel_min_share):
+    """Compare every case against the baseline, returning the list of regressions found."""
+    regressions = []
+    baseline_cases = {case_key(case): case for case in baseline['cases']}
+    for case in results['cases']:
+        key = case_key(case)
+        if key not in baseline_cases:
+            log.warning(f"{key}: not in the baseline, skipped")
+            continue
+        base = baseline_cases[key]
+
+        # Different iteration counts make the timings incomparable
+        if case['step_iterations'] != base['step_iterations']:
+            regressions.append(f"{key}: iterations {case['step_iterations']} differ from baseline {base['step_iterations']}")
+            continue
+
+        ratio = case['wallclock'] / base['wallclock'] if base['wallclock'] > 0 else 1.0
+        log.info(f"{key}: wallclock {case['wallclock']:.3f}s vs {base['wallclock']:.3f}s ({ratio:.2f}x)")
+        if ratio > 1.0 + tolerance:
+            regressions.append(f"{key}: wallclock {ratio:.2f}x the baseline, above {1.0 + tolerance:.2f}x")
+
+        for name, kernel in case['kernels'].items():
+            # Kernels too short to time reliably would only report noise
+            base_kernel = base['kernels'].get(name)
+            if not base_kernel or base_kernel['time'] <= kernel_min_share * base['wallclock']:
+                continue
+            kernel_ratio = kernel['time'] / base_kernel['time']
+            if kernel_ratio > 1.0 + kernel_tolerance:
+                regressions.append(f"{key}: {name} {kernel_ratio:.2f}x the baseline, above {1.0 + kernel_tolerance:.2f}x")
+    return regressions
+
+
+def main(args):
+    os.makedirs(args.output_dir, exist_ok=True)
+
+    results = None
+    for ranks in [int(r) for r in args.ranks.split(',')]:
+        report = run_sweep(args, ranks, args.output_dir)
+        if results is None:
+            results = {key: value for key, value in report.items() if key not in ('ranks', 'cases')}
+            results['cases'] = []
+        results['cases'] += report['cases']
+
+    results_filename = os.path.join(args.output_dir, "bench.json")
+    with open(results_filename, 'w') as results_file:
+        json.dump(results, results_file, indent=2)
+    log.info(f"Sweep results written to '{results_filename}'")
+
+    if not args.baseline:
+        return 0
+    if args.update_baseline or not os.path.exists(args.baseline):
+        with open(args.baseline, 'w') as baseline_file:
+            json.dump(results, baseline_file, indent=2)
+        log.info(f"Baseline written to '{args.baseline}'")
+        return 0
+
+    with open(args.baseline, 'r') as baseline_file:
+        baseline = json.load(baseline_file)
+    regressions = compare(results, baseline, args.tolerance, args.kernel_tolerance, args.kernel_min_share)
+    for regression in regressions:
+        log.error(regression)
+    log.info(f"{len(regressions)} regression(s) against '{args.baseline}'")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Run a strong or weak scaling sweep of TeaLeaf over grid sizes and rank counts, and check it against a baseline.")
+    parser.add_argument(
+        "--exe",
+        help="the TeaLeaf executable",
+        required=True)
+    parser.add_argument(
+        "--deck",
+        help="the input deck providing the states, solver and number of steps",
+        default="tea.in")
+    parser.add_argument(
+        "--ranks",
+        help="comma separated rank counts",
+        default="1,2,4")
+    parser.add_argument(
+        "--sizes",
+        help="comma separated grid sizes, in total for strong scaling or per rank for weak scaling",
+        default="512,1024")
+    parser.add_argument(
+        "--scaling",
+        help="'strong' or 'weak'",
+        choices=["strong", "weak"],
+        default="strong")
+    parser.add_argument(
+        "--iterations",
+        help="solver iterations per step",
+        type=int,
+        default=100)
+    parser.add_argument(
+        "--mpirun",
+        help="the MPI launcher, the rank count is appended as '-n <ranks>'",
+        default="mpirun")
+    parser.add_argument(
+        "--output-dir",
+        help="the directory the reports are written to",
+        default="target/bench")
+    parser.add_argument(
+        "--baseline",
+        help="the JSON baseline to compare with, created from this sweep if it does not exist")
+    parser.add_argument(
+        "--update-baseline",
+        help="overwrite the baseline with this sweep instead of comparing",
+        action="store_true")
+    parser.add_argument(
+        "--tolerance",
+        help="relative wallclock slowdown of a case that counts as a regression",
+        type=float,
+        default=0.10)
+    parser.add_argument(
+        "--kernel-tolerance",
+        help="relative slowdown of a single kernel that counts as a regression",
+        type=float,
+        default=0.25)
+    parser.add_argument(
+        "--kernel-min-share",
+        help="fraction of the case wallclock below which a kernel is not compared",
+        type=float,
+        default=0.05)
+
+    sys.exit(main(parser.parse_args()))
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "comms.h"
+#include "drivers.h"
+#include "kernel_interface.h"
+#include "shared.h"
+
+/*
+ *		HALO EXCHANGE MICRO-BENCHMARK
+ *		Times remote_halo_driver over every combination of exchanged fields and halo depths, with
+ *		blocking and non-blocking messages, derived datatypes, a neighbourhood collective, one-sided puts
+ *		and through shared memory, between ranks emulated as threads of this process. Each measurement
+ *		is followed by one checked exchange, so that a mode moving the wrong cells fails.
+ */
+
+#define DEF_HALO_BENCH_RANKS 4
+#define DEF_HALO_BENCH_SIZE 512
+#define DEF_HALO_BENCH_WARMUP 3
+#define DEF_HALO_BENCH_REPS 20
+
+struct HaloBenchOptions {
+  int ranks;
+  int size;
+  int warmup;
+  int reps;
+  int max_depth;
+};
+
+static const char *field_names[NUM_FIELDS] = {"density", "energy0", "energy1", "u", "p", "sd"};
+
+static void print_usage() {
+  printf("halo-bench <options>\n");
+  printf("options:\n");
+  printf("\t--ranks <n>:\n");
+  printf("\t\tRanks to emulate, one thread each. Defaults to %d.\n", DEF_HALO_BENCH_RANKS);
+  printf("\t--size <n>:\n");
+  printf("\t\tSquare interior grid size of each rank. Defaults to %d.\n", DEF_HALO_BENCH_SIZE);
+  printf("\t--warmup <n>:\n");
+  printf("\t\tUntimed exchanges before each measurement. Defaults to %d.\n", DEF_HALO_BENCH_WARMUP);
+  printf("\t--reps <n>:\n");
+  printf("\t\tTimed exchanges per measurement. Defaults to %d.\n", DEF_HALO_BENCH_REPS);
+  printf("\t--depths <n>:\n");
+  printf("\t\tSweeps halo depths from 1 up to n. Defaults to the halo depth, %d.\n", DEF_HALO_DEPTH);
+}
+
+static HaloBenchOptions parse_options(int argc, char **argv) {
+  HaloBenchOptions options{DEF_HALO_BENCH_RANKS, DEF_HALO_BENCH_SIZE, DEF_HALO_BENCH_WARMUP, DEF_HALO_BENCH_REPS, DEF_HALO_DEPTH};
+  for (int aa = 1; aa < argc; ++aa) {
+    if (tealeaf_strmatch(argv[aa], "-help") || tealeaf_strmatch(argv[aa], "--help") || tealeaf_strmatch(argv[aa], "-h")) {
+      print_usage();
+      std::exit(EXIT_SUCCESS);
+    }
+    if (aa + 1 == argc) {
+      die(__LINE__, __FILE__, "Missing value for option %s\n", argv[aa]);
+    }
+    if (tealeaf_strmatch(argv[aa], "--ranks")) {
+      options.ranks = std::max(1, std::atoi(argv[++aa]));
+    } else if (tealeaf_strmatch(argv[aa], "--size")) {
+      options.size = std::max(1, std::atoi(argv[++aa]));
+    } else if (tealeaf_strmatch(argv[aa], "--warmup")) {
+      options.warmup = std::max(0, std::atoi(argv[++aa]));
+    } else if (tealeaf_strmatch(argv[aa], "--reps")) {
+      options.reps = std::max(1, std::atoi(argv[++aa]));
+    } else if (tealeaf_strmatch(argv[aa], "--depths")) {
+      options.max_depth = std::max(1, std::atoi(argv[++aa]));
+    } else {
+      die(__LINE__, __FILE__, "Unrecognised option %s\n", argv[aa]);
+    }
+  }
+  return options;
+}
+
+// The most square factorisation of the ranks, as TeaLeaf decomposes its mesh
+static void decompose_ranks(int ranks, int *x_ranks, int *y_ranks) {
+  *x_ranks = static_cast<int>(std::sqrt(static_cast<double>(ranks)));
+  while (ranks % *x_ranks) {
+    --*x_ranks;
+  }
+  *y_ranks = ranks / *x_ranks;
+}
+
+static std::string mask_fields(int mask) {
+  std::string fields;
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    if (!(mask & (1 << ff))) continue;
+    if (!fields.empty()) fields += ",";
+    fields += field_names[ff];
+  }
+  return fields;
+}
+
+// Doubles this rank sends in one exchange, every face with a neighbour carries depth rows of each field
+static long exchange_doubles(Chunk *chunk, int depth, int num_fields) {
+  int neighbour_ranks[NUM_NEIGHBOURS];
+  get_cart_neighbour_ranks(1, neighbour_ranks);
+  long doubles = 0;
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (neighbour_ranks[nn] == MPI_PROC_NULL) continue;
+    doubles += static_cast<long>(depth) * num_fields * (nn == LEFT || nn == RIGHT ? chunk->y : chunk->x);
+  }
+  return doubles;
+}
+
+static FieldBufferType bench_field(Chunk *chunk, int ff) {
+  switch (ff) {
+    case FIELD_DENSITY: return chunk->density;
+    case FIELD_ENERGY0: return chunk->energy0;
+    case FIELD_ENERGY1: return chunk->energy;
+    case FIELD_U: return chunk->u;
+    case FIELD_P: return chunk->p;
+    case FIELD_SD: return chunk->sd;
+    default: die(__LINE__, __FILE__, "Incorrect field provided: %d.\n", ff + 1);
+  }
+  return FieldBufferType{};
+}
+
+// A value no other cell or field holds, so a halo cell matching it came from the right cell of the right neighbour
+static double cell_value(int ff, int grid_x, int xx, int yy) {
+  return 1.0 + ff + NUM_FIELDS * (xx + static_cast<double>(grid_x) * yy);
+}
+
+// Fills the interior of each exchanged field from the global position of its cells, which follows from the rank's cartesian
+// coordinates, then exchanges once and checks every halo cell facing a neighbour up to the depth
+static void check_exchange(Chunk *chunk, Settings &settings, int depth, int grid_x, const char *mode_name) {
+  int neighbour_ranks[NUM_NEIGHBOURS];
+  get_cart_neighbour_ranks(1, neighbour_ranks);
+  int halo = settings.halo_depth;
+  int left = settings.cart_coords[X_AXIS] * (chunk->x - 2 * halo);
+  int bottom = settings.cart_coords[Y_AXIS] * (chunk->y - 2 * halo);
+
+  std::vector<double> host(static_cast<size_t>(chunk->x) * chunk->y);
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    if (!settings.fields_to_exchange[ff]) continue;
+    for (int jj = 0; jj < chunk->y; ++jj) {
+      for (int kk = 0; kk < chunk->x; ++kk) {
+        bool inner = jj >= halo && jj < chunk->y - halo && kk >= halo && kk < chunk->x - halo;
+        host[kk + jj * chunk->x] = inner ? cell_value(ff, grid_x, left + kk - halo, bottom + jj - halo) : 0.0;
+      }
+    }
+    run_field_from_host(chunk, settings, host.data(), bench_field(chunk, ff));
+  }
+
+  remote_halo_driver(chunk, settings, depth);
+
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    if (!settings.fields_to_exchange[ff]) continue;
+    run_field_to_host(chunk, settings, bench_field(chunk, ff), host.data());
+    for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+      if (neighbour_ranks[nn] == MPI_PROC_NULL) continue;
+      int first_row = halo, last_row = chunk->y - halo, first_col = halo, last_col = chunk->x - halo;
+      if (nn == LEFT) first_col = halo - depth, last_col = halo;
+      if (nn == RIGHT) first_col = chunk->x - halo, last_col = chunk->x - halo + depth;
+      if (nn == DOWN) first_row = halo - depth, last_row = halo;
+      if (nn == UP) first_row = chunk->y - halo, last_row = chunk->y - halo + depth;
+      for (int jj = first_row; jj < last_row; ++jj) {
+        for (int kk = first_col; kk < last_col; ++kk) {
+          double expected = cell_value(ff, grid_x, left + kk - halo, bottom + jj - halo);
+          if (host[kk + jj * chunk->x] != expected) {
+            die(__LINE__, __FILE__, "%s exchanged %s wrongly at depth %d: rank %d cell (%d,%d) holds %g, expected %g\n", mode_name,
+                field_names[ff], depth, settings.rank, kk, jj, host[kk + jj * chunk->x], expected);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void bench_rank(const HaloBenchOptions &options) {
+  Settings settings;
+  set_default_settings(settings);
+  initialise_ranks(settings);
+  settings.halo_depth = std::max(settings.halo_depth, options.max_depth);
+  settings.staging_buffer = false;
+
+  // Kernel initialisation may log, the bench itself only reports to stdout
+  settings.tea_out_fp = std::fopen("/dev/null", "w");
+  run_model_info(settings);
+
+  int x_ranks, y_ranks;
+  decompose_ranks(settings.num_ranks, &x_ranks, &y_ranks);
+  initialise_cart_topology(x_ranks, y_ranks, settings, nullptr);
+
+  Chunk *chunk = static_cast<Chunk *>(std::calloc(1, sizeof(Chunk)));
+  initialise_chunk(chunk, settings, options.size, options.size);
+  run_kernel_initialise(chunk, settings, chunk->y * settings.halo_depth * NUM_FIELDS, chunk->x * settings.halo_depth * NUM_FIELDS);
+
+  if (settings.rank == MASTER) {
+    printf("Model: %s\n", settings.model_name.c_str());
+    printf("Ranks: %d (%dx%d), %dx%d cells each\n", settings.num_ranks, x_ranks, y_ranks, options.size, options.size);
+    printf("Warm-up exchanges: %d, timed exchanges: %d\n", options.warmup, options.reps);
+  }
+
+  // Ranks are threads of one process, so the shared-memory pass exchanges every face in place
+  const HaloExchange modes[] = {HaloExchange::BLOCKING, HaloExchange::NONBLOCKING, HaloExchange::BLOCKING, HaloExchange::NEIGHBOURHOOD,
+                                HaloExchange::RMA, HaloExchange::BLOCKING};
+  const char *mode_names[] = {"Blocking messages", "Non-blocking messages", "Derived datatypes", "Neighbourhood collective",
+                              "One-sided RMA", "Shared memory"};
+  for (int mm = 0; mm < 6; ++mm) {
+    settings.halo_exchange = modes[mm];
+    settings.datatype_halos = mm == 2;
+    settings.shared_halos = mm == 5;
+    initialise_shared_halos(settings, chunk);
+    initialise_rma_halos(settings, chunk);
+    if (settings.rank == MASTER) {
+      printf("\n %s:\n\n", mode_names[mm]);
+      printf(" %-40s%8s%16s%14s%10s\n", "Fields", "Depth", "Exchange (us)", "Bytes", "GB/s");
+    }
+
+    for (int mask = 1; mask < (1 << NUM_FIELDS); ++mask) {
+      int num_fields = 0;
+      for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+        settings.fields_to_exchange[ff] = mask & (1 << ff);
+        num_fields += settings.fields_to_exchange[ff];
+      }
+
+      for (int depth = 1; depth <= options.max_depth; ++depth) {
+        for (int ww = 0; ww < options.warmup; ++ww) {
+          remote_halo_driver(chunk, settings, depth);
+        }
+
+        // The slowest rank bounds the exchange
+        barrier();
+        double start = profiler_now();
+        for (int rr = 0; rr < options.reps; ++rr) {
+          remote_halo_driver(chunk, settings, depth);
+        }
+        double elapsed = (profiler_now() - start) / options.reps;
+        double max_elapsed;
+        MPI_Allreduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+        check_exchange(chunk, settings, depth, x_ranks * options.size, mode_names[mm]);
+
+        long doubles = exchange_doubles(chunk, depth, num_fields), total_doubles;
+        MPI_Allreduce(&doubles, &total_doubles, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+        if (settings.rank == MASTER) {
+          double bytes = static_cast<double>(total_doubles) * sizeof(double);
+          printf(" %-40s%8d%16.03F%14.0F%10.02F\n", mask_fields(mask).c_str(), depth, max_elapsed * 1.0E6, bytes,
+                 max_elapsed > 0.0 ? bytes / max_elapsed * 1.0E-9 : 0.0);
+        }
+      }
+    }
+  }
+
+  finalise_shared_halos();
+  finalise_rma_halos();
+  finalise_halo_datatypes();
+  run_kernel_finalise(chunk, settings);
+  finalise_chunk(chunk);
+  std::free(chunk);
+  std::free(settings.cart_coords);
+  finalise_log(settings);
+  profiler_finalise(&settings.kernel_profile);
+}
+
+int main(int argc, char **argv) {
+  HaloBenchOptions options = parse_options(argc, argv);
+  MPI_Init(&argc, &argv);
+  mpi_threads_launch(options.ranks, [&] { bench_rank(options); });
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "kernel_interface.h"
+#include "kernel_traffic.h"
+#include "shared.h"
+
+#ifdef USE_OMP
+  #include <omp.h>
+#endif
+#ifdef USE_KOKKOS
+  #include <Kokkos_Core.hpp>
+#endif
+
+/*
+ *		KERNEL MICRO-BENCHMARK
+ *		Times each compute kernel of kernel_interface.h in isolation over a sweep of grid sizes and
+ *		thread counts, without MPI, and reports the effective bandwidth of the kernel traffic model.
+ */
+
+#define DEF_BENCH_SIZES "128,256,512,1024,2048"
+#define DEF_BENCH_WARMUP 3
+#define DEF_BENCH_REPS 20
+
+struct BenchOptions {
+  std::vector<int> sizes;
+  std::vector<int> threads;
+  int warmup;
+  int reps;
+  std::string filter;
+};
+
+struct BenchKernel {
+  const char *name;
+  std::function<void(Chunk *, Settings &)> run;
+};
+
+// Statistics over the repetitions of one kernel, in seconds
+struct BenchStatistics {
+  double min;
+  double median;
+  double mean;
+  double stddev;
+};
+
+static std::vector<int> parse_list(const char *list) {
+  std::vector<int> values;
+  std::stringstream stream(list);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    int parsed = std::atoi(value.c_str());
+    if (parsed < 1) {
+      die(__LINE__, __FILE__, "Invalid list entry '%s' in '%s'\n", value.c_str(), list);
+    }
+    values.push_back(parsed);
+  }
+  return values;
+}
+
+static void print_usage() {
+  printf("tealeaf-kernel-bench <options>\n");
+  printf("options:\n");
+  printf("\t--sizes <n,...>:\n");
+  printf("\t\tSquare interior grid sizes to sweep. Defaults to %s.\n", DEF_BENCH_SIZES);
+  printf("\t--threads <n,...>:\n");
+  printf("\t\tThread counts to sweep, OpenMP only. Defaults to the OpenMP default.\n");
+  printf("\t--warmup <n>:\n");
+  printf("\t\tUntimed calls before each measurement. Defaults to %d.\n", DEF_BENCH_WARMUP);
+  printf("\t--reps <n>:\n");
+  printf("\t\tTimed calls per measurement. Defaults to %d.\n", DEF_BENCH_REPS);
+  printf("\t--kernel <name>:\n");
+  printf("\t\tOnly runs the kernels whose name contains the given string.\n");
+}
+
+static BenchOptions parse_options(int argc, char **argv) {
+  BenchOptions options{parse_list(DEF_BENCH_SIZES), {}, DEF_BENCH_WARMUP, DEF_BENCH_REPS, ""};
+  for (int aa = 1; aa < argc; ++aa) {
+    if (tealeaf_strmatch(argv[aa], "-help") || tealeaf_strmatch(argv[aa], "--help") || tealeaf_strmatch(argv[aa], "-h")) {
+      print_usage();
+      std::exit(EXIT_SUCCESS);
+    }
+    if (aa + 1 == argc) {
+      die(__LINE__, __FILE__, "Missing value for option %s\n", argv[aa]);
+    }
+    if (tealeaf_strmatch(argv[aa], "--sizes")) {
+      options.sizes = parse_list(argv[++aa]);
+    } else if (tealeaf_strmatch(argv[aa], "--threads")) {
+      options.threads = parse_list(argv[++aa]);
+    } else if (tealeaf_strmatch(argv[aa], "--warmup")) {
+      options.warmup = std::max(0, std::atoi(argv[++aa]));
+    } else if (tealeaf_strmatch(argv[aa], "--reps")) {
+      options.reps = std::max(1, std::atoi(argv[++aa]));
+    } else if (tealeaf_strmatch(argv[aa], "--kernel")) {
+      options.filter = argv[++aa];
+    } else {
+      die(__LINE__, __FILE__, "Unrecognised option %s\n", argv[aa]);
+    }
+  }
+
+#ifdef USE_OMP
+  if (options.threads.empty()) options.threads.push_back(omp_get_max_threads());
+#else
+  if (!options.threads.empty()) {
+    printf("Ignoring --threads, only the OpenMP model can change its thread count at runtime\n");
+  }
+  options.threads = {0};
+#endif
+  return options;
+}
+
+// Kernels may return before the device has finished
+static void bench_fence() {
+#ifdef USE_KOKKOS
+  Kokkos::fence();
+#endif
+}
+
+// Halo kernels are left out, they query the cartesian communicator. Scalar arguments keep the fields bounded over repeated calls
+static std::vector<BenchKernel> bench_kernels() {
+  const double rx = 0.1, ry = 0.1;
+  static double result[4];
+  return {
+      {"run_cg_init", [=](Chunk *chunk, Settings &settings) { run_cg_init(chunk, settings, rx, ry, result); }},
+      {"run_cg_calc_w", [](Chunk *chunk, Settings &settings) { run_cg_calc_w(chunk, settings, result); }},
+      {"run_cg_calc_ur", [](Chunk *chunk, Settings &settings) { run_cg_calc_ur(chunk, settings, 1.0E-6, result); }},
+      {"run_cg_calc_p", [](Chunk *chunk, Settings &settings) { run_cg_calc_p(chunk, settings, 0.5); }},
+      {"run_cheby_init", [](Chunk *chunk, Settings &settings) { run_cheby_init(chunk, settings); }},
+      {"run_cheby_iterate", [](Chunk *chunk, Settings &settings) { run_cheby_iterate(chunk, settings, 0.5, 0.1); }},
+      {"run_jacobi_init", [=](Chunk *chunk, Settings &settings) { run_jacobi_init(chunk, settings, rx, ry); }},
+      {"run_jacobi_iterate", [](Chunk *chunk, Settings &settings) { run_jacobi_iterate(chunk, settings, result); }},
+      {"run_ppcg_init", [](Chunk *chunk, Settings &settings) { run_ppcg_init(chunk, settings); }},
+      {"run_ppcg_inner_iteration", [](Chunk *chunk, Settings &settings) { run_ppcg_inner_iteration(chunk, settings, 0.5, 0.1); }},
+      {"run_copy_u", [](Chunk *chunk, Settings &settings) { run_copy_u(chunk, settings); }},
+      {"run_calculate_residual", [](Chunk *chunk, Settings &settings) { run_calculate_residual(chunk, settings); }},
+      {"run_calculate_2norm", [](Chunk *chunk, Settings &settings) { run_calculate_2norm(chunk, settings, chunk->r, result); }},
+      {"run_finalise", [](Chunk *chunk, Settings &settings) { run_finalise(chunk, settings); }},
+      {"run_store_energy", [](Chunk *chunk, Settings &settings) { run_store_energy(chunk, settings); }},
+      {"run_field_summary",
+       [](Chunk *chunk, Settings &settings) { run_field_summary(chunk, settings, &result[0], &result[1], &result[2], &result[3]); }},
+  };
+}
+
+// Resizes the chunk within its allocation and fills it with a hot square on a cold background, through the kernels themselves
+static void bench_reset_chunk(Chunk *chunk, Settings &settings, int size, State *states) {
+  chunk->x = size + 2 * settings.halo_depth;
+  chunk->y = size + 2 * settings.halo_depth;
+  settings.dx = (settings.grid_x_max - settings.grid_x_min) / size;
+  settings.dy = (settings.grid_y_max - settings.grid_y_min) / size;
+
+  double result;
+  run_set_chunk_data(chunk, settings);
+  run_set_chunk_state(chunk, settings, states);
+  run_store_energy(chunk, settings);
+  run_cg_init(chunk, settings, 0.1, 0.1, &result);
+  run_cheby_init(chunk, settings);
+  run_ppcg_init(chunk, settings);
+  bench_fence();
+}
+
+static BenchStatistics bench_statistics(std::vector<double> times) {
+  std::sort(times.begin(), times.end());
+  size_t mid = times.size() / 2;
+  double median = times.size() % 2 ? times[mid] : 0.5 * (times[mid - 1] + times[mid]);
+  double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+  double variance = 0.0;
+  for (double time : times) {
+    variance += (time - mean) * (time - mean);
+  }
+  return {times.front(), median, mean, std::sqrt(variance / times.size())};
+}
+
+static BenchStatistics bench_kernel(const BenchKernel &kernel, Chunk *chunk, Settings &settings, const BenchOptions &options) {
+  for (int ww = 0; ww < options.warmup; ++ww) {
+    kernel.run(chunk, settings);
+  }
+  bench_fence();
+
+  std::vector<double> times(options.reps);
+  for (int rr = 0; rr < options.reps; ++rr) {
+    double start = profiler_now();
+    kernel.run(chunk, settings);
+    bench_fence();
+    times[rr] = profiler_now() - start;
+  }
+  return bench_statistics(times);
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options = parse_options(argc, argv);
+
+  Settings settings;
+  set_default_settings(settings);
+  settings.rank = MASTER;
+  settings.num_ranks = 1;
+  reset_fields_to_exchange(settings);
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    settings.fields_to_exchange[ff] = true;
+  }
+
+  // Kernel initialisation may log, the bench itself only reports to stdout
+  settings.tea_out_fp = std::fopen("/dev/null", "w");
+
+  run_model_info(settings);
+
+  State states[2] = {};
+  states[0] = {true, 100.0, 0.0001, 0.0, 0.0, 0.0, 0.0, 0.0, Geometry::RECTANGULAR};
+  states[1] = {true, 0.1, 25.0, 0.0, 0.0, 5.0, 5.0, 0.0, Geometry::RECTANGULAR};
+  settings.num_states = 2;
+
+  // One allocation at the largest size, smaller sizes run within it
+  int max_size = *std::max_element(options.sizes.begin(), options.sizes.end());
+  Chunk *chunk = static_cast<Chunk *>(std::calloc(1, sizeof(Chunk)));
+  initialise_chunk(chunk, settings, max_size, max_size);
+  chunk->theta = 1.0;
+  run_kernel_initialise(chunk, settings, chunk->y * settings.halo_depth * NUM_FIELDS, chunk->x * settings.halo_depth * NUM_FIELDS);
+
+  printf("Model: %s\n", settings.model_name.c_str());
+  printf("Warm-up calls: %d, timed calls: %d\n", options.warmup, options.reps);
+
+  std::vector<BenchKernel> kernels = bench_kernels();
+  for (int threads : options.threads) {
+#ifdef USE_OMP
+    omp_set_num_threads(threads);
+#endif
+    for (int size : options.sizes) {
+      long cells = static_cast<long>(size) * size;
+      if (threads) {
+        printf("\n Grid %dx%d, %d threads:\n\n", size, size, threads);
+      } else {
+        printf("\n Grid %dx%d:\n\n", size, size);
+      }
+      printf(" %-28s%12s%12s%12s%12s%10s%10s\n", "Kernel Name", "Min (ms)", "Median (ms)", "Mean (ms)", "Stddev (ms)", "GB/s", "GFLOP/s");
+
+      for (const BenchKernel &kernel : kernels) {
+        if (!options.filter.empty() && std::string(kernel.name).find(options.filter) == std::string::npos) continue;
+
+        bench_reset_chunk(chunk, settings, size, states);
+        BenchStatistics stats = bench_kernel(kernel, chunk, settings, options);
+        printf(" %-28s%12.04F%12.04F%12.04F%12.04F", kernel.name, stats.min * 1.0E3, stats.median * 1.0E3, stats.mean * 1.0E3,
+               stats.stddev * 1.0E3);
+
+        // Bandwidth from the median, which is robust to the occasional preempted call
+        const KernelTraffic *traffic = kernel_traffic_find(kernel.name);
+        if (traffic && stats.median > 0.0) {
+          printf("%10.02F%10.02F\n", kernel_traffic_bytes(*traffic) * cells / stats.median * 1.0E-9,
+                 static_cast<double>(traffic->flops) * cells / stats.median * 1.0E-9);
+        } else {
+          printf("%10s%10s\n", "-", "-");
+        }
+      }
+    }
+  }
+
+  chunk->x = max_size + 2 * settings.halo_depth;
+  chunk->y = max_size + 2 * settings.halo_depth;
+  run_kernel_finalise(chunk, settings);
+  finalise_chunk(chunk);
+  std::free(chunk);
+  finalise_log(settings);
+  profiler_finalise(&settings.kernel_profile);
+  return EXIT_SUCCESS;
+}
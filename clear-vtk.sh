@@ -1,3 +1,5 @@
 #!/usr/bin/env bash
 rm ./target/vtk/*.vtk
+rm ./target/vtk/*.vtr
+rm ./target/vtk/*.pvtr
 rm ./target/vtk/postprocess/*.vtk
\ No newline at end of file
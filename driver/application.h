@@ -6,8 +6,14 @@
 
 void initialise_model_info(Settings &settings);
 void initialise_application(Chunk **chunks, Settings &settings, State * states);
+void initialise_fields(Chunk *chunks, Settings &settings, State *states);
+void initialise_halo_exchange(Chunk *chunks, Settings &settings);
+void calc_chunk_extents(const Settings &settings, int xx, int yy, int *left, int *right, int *bottom, int *top);
 bool diffuse(Chunk *chunk, Settings &settings);
+void solve(Chunk *chunks, Settings &settings, int tt, double *wallclock_prev);
 void read_config(Settings &settings, State **states);
+void read_config_overrides(Settings &settings, State **states, const char *overrides);
+void read_test_problems(Settings &settings);
 
 #ifdef DIFFUSE_OVERLOAD
 bool diffuse_overload(Chunk *chunk, Settings &settings);
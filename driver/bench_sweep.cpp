@@ -0,0 +1,165 @@
+#include "bench_sweep.h"
+#include "application.h"
+#include "comms.h"
+#include "drivers.h"
+#include "kernel_interface.h"
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Timings of one grid size, as seen from the master
+struct BenchCase {
+  int x_cells;
+  int y_cells;
+  std::vector<double> step_wallclocks;
+  std::vector<int> step_iterations;
+  std::vector<ProfileEntry> kernels;
+};
+
+static std::vector<int> bench_sweep_sizes(const char *list) {
+  std::vector<int> sizes;
+  std::stringstream stream(list);
+  std::string size;
+  while (std::getline(stream, size, ',')) {
+    int parsed = std::atoi(size.c_str());
+    if (parsed < 1) {
+      die(__LINE__, __FILE__, "Invalid grid size '%s' in --bench-sweep %s\n", size.c_str(), list);
+    }
+    sizes.push_back(parsed);
+  }
+  return sizes;
+}
+
+// Weak scaling keeps size x size cells per rank, laid out on the most square factorisation of the ranks
+static void bench_sweep_grid(Settings &settings, int size) {
+  if (settings.bench_scaling == BenchScaling::STRONG) {
+    settings.grid_x_cells = size;
+    settings.grid_y_cells = size;
+  } else {
+    int x_ranks = static_cast<int>(std::sqrt(static_cast<double>(settings.num_ranks)));
+    while (settings.num_ranks % x_ranks) {
+      --x_ranks;
+    }
+    settings.grid_x_cells = size * x_ranks;
+    settings.grid_y_cells = size * (settings.num_ranks / x_ranks);
+  }
+  settings.dx = (settings.grid_x_max - settings.grid_x_min) / settings.grid_x_cells;
+  settings.dy = (settings.grid_y_max - settings.grid_y_min) / settings.grid_y_cells;
+}
+
+// Each case starts from empty profiles so that kernel times are not carried over
+static void bench_sweep_reset_profiles(Settings &settings) {
+  profiler_finalise(&settings.kernel_profile);
+  profiler_finalise(&settings.application_profile);
+  profiler_finalise(&settings.wallclock_profile);
+  settings.kernel_profile = profiler_initialise();
+  settings.application_profile = profiler_initialise();
+  settings.wallclock_profile = profiler_initialise();
+}
+
+static BenchCase bench_sweep_case(Settings &settings, State *states, int size) {
+  bench_sweep_grid(settings, size);
+  bench_sweep_reset_profiles(settings);
+  print_and_log(settings, "\n Bench case %dx%d on %d ranks\n", settings.grid_x_cells, settings.grid_y_cells, settings.num_ranks);
+
+  Chunk *chunks{};
+  initialise_application(&chunks, settings, states);
+
+  BenchCase bench_case{settings.grid_x_cells, settings.grid_y_cells, {}, {}, {}};
+  double wallclock_prev = 0.0;
+  settings.sim_time = 0.0;
+  settings.sim_steps = 0;
+  for (int tt = 1; tt <= settings.end_step && settings.sim_time < settings.end_time; ++tt) {
+    // A step lasts as long as its slowest rank
+    barrier();
+    double start = profiler_now();
+    solve(chunks, settings, tt, &wallclock_prev);
+    double elapsed = profiler_now() - start, max_elapsed;
+    MPI_Allreduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    bench_case.step_wallclocks.push_back(max_elapsed);
+    bench_case.step_iterations.push_back(settings.solve_iterations);
+  }
+  bench_case.kernels = profiler_flat_entries(settings.kernel_profile);
+
+  kernel_finalise_driver(chunks, settings);
+  for (int cc = 0; cc < settings.num_chunks_per_rank; ++cc) {
+    finalise_chunk(&(chunks[cc]));
+  }
+  std::free(chunks);
+  std::free(settings.cart_coords);
+  return bench_case;
+}
+
+static void bench_sweep_write(Settings &settings, const std::vector<BenchCase> &cases) {
+  FILE *fp = std::fopen(settings.bench_output_filename, "w");
+  if (!fp) {
+    die(__LINE__, __FILE__, "Could not open bench output file %s\n", settings.bench_output_filename);
+  }
+
+  std::fprintf(fp, "{\n  \"model\": \"%s\",\n  \"solver\": \"%s\",\n", settings.model_name.c_str(), settings.solver_name);
+  std::fprintf(fp, "  \"scaling\": \"%s\",\n", settings.bench_scaling == BenchScaling::STRONG ? "strong" : "weak");
+  std::fprintf(fp, "  \"ranks\": %d,\n  \"iterations\": %d,\n", settings.num_ranks, settings.bench_iterations);
+  std::fprintf(fp, "  \"cases\": [");
+  for (size_t cc = 0; cc < cases.size(); ++cc) {
+    const BenchCase &bench_case = cases[cc];
+    double wallclock = 0.0;
+    for (double step : bench_case.step_wallclocks) {
+      wallclock += step;
+    }
+
+    std::fprintf(fp, "%s\n    {\n", cc ? "," : "");
+    std::fprintf(fp, "      \"x_cells\": %d,\n      \"y_cells\": %d,\n      \"ranks\": %d,\n", bench_case.x_cells, bench_case.y_cells,
+                 settings.num_ranks);
+    // Decks stopping at end_time may run fewer steps than end_step
+    std::fprintf(fp, "      \"steps\": %zu,\n", bench_case.step_wallclocks.size());
+    std::fprintf(fp, "      \"wallclock\": %.9e,\n      \"step_wallclock\": [", wallclock);
+    for (size_t ss = 0; ss < bench_case.step_wallclocks.size(); ++ss) {
+      std::fprintf(fp, "%s%.9e", ss ? ", " : "", bench_case.step_wallclocks[ss]);
+    }
+    std::fprintf(fp, "],\n      \"step_iterations\": [");
+    for (size_t ss = 0; ss < bench_case.step_iterations.size(); ++ss) {
+      std::fprintf(fp, "%s%d", ss ? ", " : "", bench_case.step_iterations[ss]);
+    }
+    std::fprintf(fp, "],\n      \"kernels\": {");
+    for (size_t kk = 0; kk < bench_case.kernels.size(); ++kk) {
+      const ProfileEntry &entry = bench_case.kernels[kk];
+      std::fprintf(fp, "%s\n        \"%s\": {\"time\": %.9e, \"calls\": %ld}", kk ? "," : "", entry.name.c_str(), entry.time, entry.calls);
+    }
+    std::fprintf(fp, "%s}\n    }", bench_case.kernels.empty() ? "" : "\n      ");
+  }
+  std::fprintf(fp, "\n  ]\n}\n");
+  std::fclose(fp);
+}
+
+void bench_sweep(Settings &settings, State *states) {
+  std::vector<int> sizes = bench_sweep_sizes(settings.bench_sweep_sizes);
+
+  // Every size allocates its own chunks, finalising the kernels of the previous one and initialising them again
+  if (sizes.size() > 1 && !settings.model_reinitialisable) {
+    die(__LINE__, __FILE__, "%s cannot reinitialise its kernels, so --bench-sweep takes a single size per launch\n",
+        settings.model_name.c_str());
+  }
+
+  // An unreachable tolerance makes every solve run exactly max_iters iterations, dumps would only time the file system
+  settings.eps = 0.0;
+  settings.max_iters = settings.bench_iterations;
+  settings.visit_frequency = 0;
+
+  print_and_log(settings, "Bench sweep:\n");
+  print_and_log(settings, " - Scaling:    %s\n", settings.bench_scaling == BenchScaling::STRONG ? "strong" : "weak");
+  print_and_log(settings, " - Sizes:      %s\n", settings.bench_sweep_sizes);
+  print_and_log(settings, " - Iterations: %d per step, up to %d steps\n", settings.bench_iterations, settings.end_step);
+
+  std::vector<BenchCase> cases;
+  for (int size : sizes) {
+    cases.push_back(bench_sweep_case(settings, states, size));
+  }
+
+  if (settings.rank == MASTER) {
+    bench_sweep_write(settings, cases);
+  }
+  print_and_log(settings, " - Output:     %s\n", settings.bench_output_filename);
+}
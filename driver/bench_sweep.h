@@ -0,0 +1,17 @@
+#pragma once
+
+#include "settings.h"
+
+/*
+ *		BENCHMARK SWEEP
+ *		Reruns the deck over a list of grid sizes at the current rank count, each solve stopping after
+ *		a fixed number of iterations rather than at convergence, and writes the step and kernel timings
+ *		of every case as JSON. bench-sweep.py repeats this over rank counts and checks for regressions.
+ */
+
+#define DEF_BENCH_SCALING BenchScaling::STRONG
+#define DEF_BENCH_ITERATIONS 100
+#define DEF_BENCH_OUTPUT_FILENAME "bench.json"
+
+// Runs every case of the sweep in place of the normal solve, collective over all ranks
+void bench_sweep(Settings &settings, State *states);
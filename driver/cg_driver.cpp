@@ -5,6 +5,8 @@
 
 // Performs a full solve with the CG solver kernels
 void cg_driver(Chunk *chunks, Settings &settings, double rx, double ry, double *error) {
+  START_PROFILING(settings.kernel_profile);
+
   int tt;
   double rro = 0.0;
 
@@ -19,8 +21,11 @@ void cg_driver(Chunk *chunks, Settings &settings, double rx, double ry, double *
 
     if (sqrt(fabs(*error)) < settings.eps) break;
   }
+  settings.solve_iterations = tt;
+
+  print_and_log_at(settings, LOG_STEP, " CG: \t\t\t%d iterations\n", tt);
 
-  print_and_log(settings, " CG: \t\t\t%d iterations\n", tt);
+  STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
 // Invokes the CG initialisation kernels
@@ -9,6 +9,8 @@ void cheby_calc_est_iterations(Chunk *chunks, double error, double bb, int *est_
 
 // Performs full solve with the Chebyshev kernels
 void cheby_driver(Chunk *chunks, Settings &settings, double rx, double ry, double *error) {
+  START_PROFILING(settings.kernel_profile);
+
   int tt;
   double rro = 0.0;
   int est_iterations = 0;
@@ -55,9 +57,12 @@ void cheby_driver(Chunk *chunks, Settings &settings, double rx, double ry, doubl
 
     if (fabs(*error) < settings.eps) break;
   }
+  settings.solve_iterations = tt;
+
+  print_and_log_at(settings, LOG_STEP, "CG: \t\t\t%d iterations\n", tt - num_cheby_iters + 1);
+  print_and_log_at(settings, LOG_STEP, "Cheby: \t\t\t%d iterations (%d estimated)\n", num_cheby_iters, est_iterations);
 
-  print_and_log(settings, "CG: \t\t\t%d iterations\n", tt - num_cheby_iters + 1);
-  print_and_log(settings, "Cheby: \t\t\t%d iterations (%d estimated)\n", num_cheby_iters, est_iterations);
+  STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
 // Invokes the Chebyshev initialisation kernels
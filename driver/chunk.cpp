@@ -63,6 +63,7 @@ void initialise_chunk(Chunk *chunk, Settings &settings, int x, int y) {
   chunk->x = x + settings.halo_depth * 2;
   chunk->y = y + settings.halo_depth * 2;
   chunk->dt_init = settings.dt_init;
+  chunk->dt = settings.dt_init;
 
   // Allocate the MPI comm buffers
   //  int lr_len = chunk->y * settings.halo_depth * NUM_FIELDS;
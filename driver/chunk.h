@@ -8,6 +8,7 @@
 struct Chunk {
   // Solve-wide variables
   double dt_init;
+  double dt;
 
   // MPI comm buffers
   FieldBufferType left_send;
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "settings.h"
+#include <algorithm>
+#include <cmath>
+
+/*
+ *		CHUNK STATE GEOMETRY
+ *		Tests which cells of a chunk a state covers, for the host set chunk state kernels. Each state
+ *		is first clipped to the rows and columns it can touch so that the fill skips the rest of the
+ *		chunk, and the cells it covers in part may be mixed by their volume fraction.
+ */
+
+// The host coordinates of a chunk's vertices and cell centres
+struct StateMesh {
+  int x;
+  int y;
+  const double *vertex_x;
+  const double *vertex_y;
+  const double *cell_x;
+  const double *cell_y;
+};
+
+// Half-open ranges of the rows and columns a state may cover, empty when it misses the chunk
+struct StateCells {
+  int first_row;
+  int last_row;
+  int first_col;
+  int last_col;
+};
+
+// A cell is covered by a rectangle it overlaps, a circle holding its centre or a point on its lower left vertex
+inline bool state_covers(const State &state, const StateMesh &mesh, int jj, int kk) {
+  if (state.geometry == Geometry::RECTANGULAR) {
+    return mesh.vertex_x[kk + 1] >= state.x_min && mesh.vertex_x[kk] < state.x_max && mesh.vertex_y[jj + 1] >= state.y_min &&
+           mesh.vertex_y[jj] < state.y_max;
+  } else if (state.geometry == Geometry::CIRCULAR) {
+    double radius = std::sqrt((mesh.cell_x[kk] - state.x_min) * (mesh.cell_x[kk] - state.x_min) +
+                              (mesh.cell_y[jj] - state.y_min) * (mesh.cell_y[jj] - state.y_min));
+    return radius <= state.radius;
+  } else if (state.geometry == Geometry::POINT) {
+    return mesh.vertex_x[kk] == state.x_min && mesh.vertex_y[jj] == state.y_min;
+  }
+  return false;
+}
+
+// Rectangles and points are clipped exactly by the same comparisons as state_covers. Circles keep one more cell on each side of
+// their bounding box, so rounding at its edges never drops a covered cell
+inline StateCells state_cells(const State &state, const StateMesh &mesh) {
+  auto clip = [](const double *vertices, const double *centres, int n, double min, double max, double radius, Geometry geometry) {
+    int first = 0, last = 0;
+    if (geometry == Geometry::RECTANGULAR) {
+      first = static_cast<int>(std::lower_bound(vertices + 1, vertices + n + 1, min) - (vertices + 1));
+      last = static_cast<int>(std::lower_bound(vertices, vertices + n, max) - vertices);
+    } else if (geometry == Geometry::CIRCULAR) {
+      first = static_cast<int>(std::lower_bound(centres, centres + n, min - radius) - centres) - 1;
+      last = static_cast<int>(std::upper_bound(centres, centres + n, min + radius) - centres) + 1;
+    } else if (geometry == Geometry::POINT) {
+      first = static_cast<int>(std::lower_bound(vertices, vertices + n, min) - vertices);
+      last = static_cast<int>(std::upper_bound(vertices, vertices + n, min) - vertices);
+    }
+    first = std::max(first, 0);
+    return std::make_pair(first, std::max(first, std::min(last, n)));
+  };
+  auto cols = clip(mesh.vertex_x, mesh.cell_x, mesh.x, state.x_min, state.x_max, state.radius, state.geometry);
+  auto rows = clip(mesh.vertex_y, mesh.cell_y, mesh.y, state.y_min, state.y_max, state.radius, state.geometry);
+  return {rows.first, rows.second, cols.first, cols.second};
+}
+
+// Whether a point lies in a rectangle or circle, with the bounds of state_covers
+inline bool state_holds(const State &state, double px, double py) {
+  if (state.geometry == Geometry::RECTANGULAR) {
+    return px >= state.x_min && px < state.x_max && py >= state.y_min && py < state.y_max;
+  }
+  return (px - state.x_min) * (px - state.x_min) + (py - state.y_min) * (py - state.y_min) <= state.radius * state.radius;
+}
+
+// The fraction of a cell inside a rectangle or circle, sampled at samples by samples points. Both shapes are convex, so a cell
+// whose corners are all inside is wholly inside. Points have no area and cover their cell whole
+inline double state_fraction(const State &state, const StateMesh &mesh, int jj, int kk, int samples) {
+  if (state.geometry == Geometry::POINT) return state_covers(state, mesh, jj, kk) ? 1.0 : 0.0;
+
+  double x0 = mesh.vertex_x[kk], x1 = mesh.vertex_x[kk + 1];
+  double y0 = mesh.vertex_y[jj], y1 = mesh.vertex_y[jj + 1];
+  if (state_holds(state, x0, y0) && state_holds(state, x1, y0) && state_holds(state, x0, y1) && state_holds(state, x1, y1)) {
+    return 1.0;
+  }
+  int inside = 0;
+  for (int ss = 0; ss < samples; ++ss) {
+    double py = y0 + (y1 - y0) * (ss + 0.5) / samples;
+    for (int tt = 0; tt < samples; ++tt) {
+      inside += state_holds(state, x0 + (x1 - x0) * (tt + 0.5) / samples, py);
+    }
+  }
+  return static_cast<double>(inside) / (samples * samples);
+}
+
+// Mixes the state into a cell by volume fraction, its density by volume and its specific energy by mass
+inline void mix_state(const State &state, double fraction, double *density, double *energy) {
+  if (fraction >= 1.0) {
+    *density = state.density;
+    *energy = state.energy;
+  } else if (fraction > 0.0) {
+    double mixed_density = fraction * state.density + (1.0 - fraction) * *density;
+    *energy = (fraction * state.density * state.energy + (1.0 - fraction) * *density * *energy) / mixed_density;
+    *density = mixed_density;
+  }
+}
@@ -1,28 +1,161 @@
 #include "comms.h"
 #include "fault_manager.h"
+#include "profiler.h"
 #include "settings.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <new>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
+// The ranks solving together, all of them unless split into ensemble groups
+#ifdef MPI_THREADS
+// Every rank thread holds its own handle
+thread_local MPI_Comm world_communicator = MPI_COMM_WORLD;
+thread_local MPI_Comm cart_communicator;
+#else
+MPI_Comm world_communicator = MPI_COMM_WORLD;
 MPI_Comm cart_communicator;
+#endif
+
+// Each rank's segment of the shared-memory window starts with the progress of its faces, indexed by CART_NEIGHBOUR. The owner
+// publishes the generation of the data packed for a face in posted, and in released the generation it has read from the neighbour
+// across that face, so that every counter has a single writer
+struct SharedHaloHeader {
+  std::atomic<long> posted[NUM_NEIGHBOURS];
+  std::atomic<long> released[NUM_NEIGHBOURS];
+  long offsets[NUM_NEIGHBOURS];
+};
+
+struct SharedHalos {
+  bool allocated;
+  MPI_Comm node_communicator;
+  MPI_Win window;
+  SharedHaloHeader *own;
+  SharedHaloHeader *neighbours[NUM_NEIGHBOURS];
+  long generation[NUM_NEIGHBOURS];
+};
+
+#ifdef MPI_THREADS
+thread_local SharedHalos shared_halos{};
+#else
+SharedHalos shared_halos{};
+#endif
+
+// Derived datatypes describing the halo regions of the fields in place, built on first use for each combination of exchanged
+// fields, face, depth and direction, and rebuilt once the fields are reallocated
+struct HaloDatatypes {
+  double *fields[NUM_FIELDS];
+  int x;
+  int y;
+  std::map<int, MPI_Datatype> types;
+};
+
+#ifdef MPI_THREADS
+thread_local HaloDatatypes halo_datatypes{};
+#else
+HaloDatatypes halo_datatypes{};
+#endif
+
+// The faces of every neighbour one after another in neighbour order, which is that of a cartesian communicator, exchanged by one
+// neighbourhood collective. Faces have the same length on both sides, so the send and receive layouts match
+struct NeighbourHalos {
+  std::vector<double> send;
+  std::vector<double> recv;
+  int counts[NUM_NEIGHBOURS];
+  int displs[NUM_NEIGHBOURS];
+  MPI_Request request;
+};
+
+#ifdef MPI_THREADS
+thread_local NeighbourHalos neighbour_halos{};
+#else
+NeighbourHalos neighbour_halos{};
+#endif
+
+// Each rank's window holds one receive segment per face, in neighbour order, that the neighbour across the face puts its halo into
+// during post-start-complete-wait epochs. Faces are packed into send before the put, and offsets holds where in each neighbour's
+// window the segment facing this rank starts. The group of neighbours taking part is kept until the faces exchanged change
+struct RmaHalos {
+  bool allocated;
+  MPI_Win window;
+  double *segments;
+  long lengths[NUM_NEIGHBOURS];
+  long own_offsets[NUM_NEIGHBOURS];
+  long offsets[NUM_NEIGHBOURS];
+  std::vector<double> send;
+  int counts[NUM_NEIGHBOURS];
+  int group_mask;
+  MPI_Group group;
+};
+
+#ifdef MPI_THREADS
+thread_local RmaHalos rma_halos{};
+#else
+RmaHalos rma_halos{};
+#endif
+
+// Seconds spent in halo messages and reductions, which include the time waiting for slower ranks
+#ifdef MPI_THREADS
+thread_local double comms_seconds = 0.0;
+#else
+double comms_seconds = 0.0;
+#endif
 
 // Initialise MPI
 void initialise_comms(int argc, char **argv) { MPI_Init(&argc, &argv); }
 
 // Initialise the rank information
 void initialise_ranks(Settings &settings) {
-  MPI_Comm_rank(MPI_COMM_WORLD, &settings.rank);
-  MPI_Comm_size(MPI_COMM_WORLD, &settings.num_ranks);
+  MPI_Comm_rank(world_communicator, &settings.rank);
+  MPI_Comm_size(world_communicator, &settings.num_ranks);
+}
+
+// Restricts all further communication to the ranks of the same group, collective over all ranks
+void split_comms(Settings &settings, int group) {
+  int world_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_split(MPI_COMM_WORLD, group, world_rank, &world_communicator);
+  initialise_ranks(settings);
+}
+
+// Returns to communicating over all ranks
+void merge_comms(Settings &settings) {
+  if (world_communicator != MPI_COMM_WORLD) {
+    MPI_Comm_free(&world_communicator);
+    world_communicator = MPI_COMM_WORLD;
+  }
+  initialise_ranks(settings);
 }
 
 // Teardown MPI
-void finalise_comms() { MPI_Finalize(); }
+void finalise_comms() {
+  finalise_shared_halos();
+  finalise_rma_halos();
+  finalise_halo_datatypes();
+  MPI_Finalize();
+}
 
 // Sends a message out and receives a message in
 void send_recv_message(Settings &settings, double *send_buffer, double *recv_buffer, int buffer_len, int neighbour_rank, int send_tag,
                        int recv_tag) {
   START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
 
   int rc;
-  if (settings.rank < neighbour_rank) {
+  if (settings.halo_exchange == HaloExchange::NONBLOCKING) {
+    // Both sides post at once instead of ordering by rank, waited on one by one as Legio does not support MPI_Waitall
+    MPI_Request requests[2];
+    MPI_Irecv(recv_buffer, buffer_len, MPI_DOUBLE, neighbour_rank, recv_tag, cart_communicator, &requests[0]);
+    MPI_Isend(send_buffer, buffer_len, MPI_DOUBLE, neighbour_rank, send_tag, cart_communicator, &requests[1]);
+    rc = MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+    MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
+  } else if (settings.cart_rank < neighbour_rank) {
     MPI_Send(send_buffer, buffer_len, MPI_DOUBLE, neighbour_rank, send_tag, cart_communicator);
     rc = MPI_Recv(recv_buffer, buffer_len, MPI_DOUBLE, neighbour_rank, recv_tag, cart_communicator, MPI_STATUS_IGNORE);
   } else {
@@ -30,43 +163,372 @@ void send_recv_message(Settings &settings, double *send_buffer, double *recv_buf
     MPI_Send(send_buffer, buffer_len, MPI_DOUBLE, neighbour_rank, send_tag, cart_communicator);
   }
 
+  TRACE_MESSAGE(neighbour_rank, buffer_len);
+
   if (settings.ft) {
     recover_on_fault(cart_communicator, settings.cart_rank, neighbour_rank, rc,                                       //
                      settings.ft_recv_strategy, settings.ft_recv_static_value, settings.ft_recv_interpolation_factor, //
                      send_buffer, recv_buffer, buffer_len);
   }
 
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// The cells of a face that are sent from, or received into, as the first cell and a strided run of blocks. Left and right faces
+// are depth columns of every inner row, bottom and top faces are depth inner rows
+static MPI_Datatype halo_region(int x, int y, int halo_depth, int face, int depth, bool send, int *first) {
+  int x_inner = x - 2 * halo_depth;
+  int y_inner = y - 2 * halo_depth;
+  MPI_Datatype region;
+  *first = 0;
+  switch (face) {
+    case CHUNK_LEFT: *first = halo_depth * x + (send ? halo_depth : halo_depth - depth); break;
+    case CHUNK_RIGHT: *first = halo_depth * x + (send ? x - halo_depth - depth : x - halo_depth); break;
+    case CHUNK_BOTTOM: *first = (send ? halo_depth : halo_depth - depth) * x + halo_depth; break;
+    case CHUNK_TOP: *first = (send ? y - halo_depth - depth : y - halo_depth) * x + halo_depth; break;
+    default: die(__LINE__, __FILE__, "Incorrect face provided: %d.\n", face);
+  }
+  if (face == CHUNK_LEFT || face == CHUNK_RIGHT) {
+    MPI_Type_vector(y_inner, depth, x, MPI_DOUBLE, &region);
+  } else {
+    MPI_Type_vector(depth, x_inner, x, MPI_DOUBLE, &region);
+  }
+  return region;
+}
+
+// One datatype covering the face of every exchanged field, in field order, addressed from MPI_BOTTOM
+static MPI_Datatype halo_datatype(Settings &settings, double *const fields[NUM_FIELDS], int x, int y, int face, int depth, bool send) {
+  bool reallocated = halo_datatypes.x != x || halo_datatypes.y != y ||
+                     !std::equal(fields, fields + NUM_FIELDS, halo_datatypes.fields, [](double *field, double *cached) {
+                       return !field || !cached || field == cached;
+                     });
+  if (reallocated) {
+    finalise_halo_datatypes();
+    halo_datatypes.x = x;
+    halo_datatypes.y = y;
+  }
+
+  int mask = 0;
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    if (!fields[ff]) continue;
+    mask |= 1 << ff;
+    halo_datatypes.fields[ff] = fields[ff];
+  }
+  int key = ((mask * NUM_FACES + face) * (settings.halo_depth + 1) + depth) * 2 + send;
+  auto found = halo_datatypes.types.find(key);
+  if (found != halo_datatypes.types.end()) return found->second;
+
+  int first;
+  MPI_Datatype region = halo_region(x, y, settings.halo_depth, face, depth, send, &first);
+  int blocklengths[NUM_FIELDS];
+  MPI_Aint displacements[NUM_FIELDS];
+  MPI_Datatype types[NUM_FIELDS];
+  int count = 0;
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    if (!fields[ff]) continue;
+    blocklengths[count] = 1;
+    MPI_Get_address(fields[ff] + first, &displacements[count]);
+    types[count] = region;
+    ++count;
+  }
+  MPI_Datatype datatype;
+  MPI_Type_create_struct(count, blocklengths, displacements, types, &datatype);
+  MPI_Type_commit(&datatype);
+  MPI_Type_free(&region);
+  halo_datatypes.types[key] = datatype;
+  return datatype;
+}
+
+// Frees the cached halo datatypes
+void finalise_halo_datatypes() {
+  for (auto &entry : halo_datatypes.types) {
+    MPI_Type_free(&entry.second);
+  }
+  halo_datatypes = {};
+}
+
+// Exchanges a face of the fields straight between the field arrays of both neighbours, without packing into buffers. Fields not
+// exchanged are null, buffer_len counts the doubles sent for tracing
+void send_recv_halo_fields(Settings &settings, double *const fields[NUM_FIELDS], int x, int y, int face, int depth, int buffer_len,
+                           int neighbour_rank, int send_tag, int recv_tag) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+
+  MPI_Datatype send_type = halo_datatype(settings, fields, x, y, face, depth, true);
+  MPI_Datatype recv_type = halo_datatype(settings, fields, x, y, face, depth, false);
+  if (settings.halo_exchange == HaloExchange::NONBLOCKING) {
+    MPI_Request requests[2];
+    MPI_Irecv(MPI_BOTTOM, 1, recv_type, neighbour_rank, recv_tag, cart_communicator, &requests[0]);
+    MPI_Isend(MPI_BOTTOM, 1, send_type, neighbour_rank, send_tag, cart_communicator, &requests[1]);
+    MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+    MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
+  } else if (settings.cart_rank < neighbour_rank) {
+    MPI_Send(MPI_BOTTOM, 1, send_type, neighbour_rank, send_tag, cart_communicator);
+    MPI_Recv(MPI_BOTTOM, 1, recv_type, neighbour_rank, recv_tag, cart_communicator, MPI_STATUS_IGNORE);
+  } else {
+    MPI_Recv(MPI_BOTTOM, 1, recv_type, neighbour_rank, recv_tag, cart_communicator, MPI_STATUS_IGNORE);
+    MPI_Send(MPI_BOTTOM, 1, send_type, neighbour_rank, send_tag, cart_communicator);
+  }
+
+  TRACE_MESSAGE(neighbour_rank, buffer_len);
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Lays out the faces of the next neighbourhood exchange, a count of zero leaving a face out, and returns where each face is packed
+// into and unpacked from, or nullptr for faces left out
+void neighbour_halo_buffers(const int counts[NUM_NEIGHBOURS], double *send_buffers[NUM_NEIGHBOURS], double *recv_buffers[NUM_NEIGHBOURS]) {
+  size_t total = 0;
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    neighbour_halos.counts[nn] = counts[nn];
+    neighbour_halos.displs[nn] = static_cast<int>(total);
+    total += counts[nn];
+  }
+  if (neighbour_halos.send.size() < total) {
+    neighbour_halos.send.resize(total);
+    neighbour_halos.recv.resize(total);
+  }
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    send_buffers[nn] = counts[nn] ? &neighbour_halos.send[neighbour_halos.displs[nn]] : nullptr;
+    recv_buffers[nn] = counts[nn] ? &neighbour_halos.recv[neighbour_halos.displs[nn]] : nullptr;
+  }
+}
+
+// Posts the exchange of the faces laid out by neighbour_halo_buffers and returns before they arrive
+void neighbour_halo_start(Settings &settings) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  MPI_Ineighbor_alltoallv(neighbour_halos.send.data(), neighbour_halos.counts, neighbour_halos.displs, MPI_DOUBLE,
+                          neighbour_halos.recv.data(), neighbour_halos.counts, neighbour_halos.displs, MPI_DOUBLE, cart_communicator,
+                          &neighbour_halos.request);
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Waits for the faces posted by neighbour_halo_start
+void neighbour_halo_wait(Settings &settings) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  MPI_Wait(&neighbour_halos.request, MPI_STATUS_IGNORE);
+
+  int neighbour_ranks[NUM_NEIGHBOURS];
+  get_cart_neighbour_ranks(1, neighbour_ranks);
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (neighbour_halos.counts[nn]) TRACE_MESSAGE(neighbour_ranks[nn], neighbour_halos.counts[nn]);
+  }
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Allocates the window the neighbours put halos into, collective over the ranks of the cartesian communicator, and returns whether
+// it did. The window is host memory, so only models whose field buffers are host pointers take part, and fault tolerance keeps
+// every message on two-sided MPI to recover from failed neighbours
+bool initialise_rma_halos(Settings &settings, const Chunk *chunk) {
+  finalise_rma_halos();
+  if (settings.halo_exchange != HaloExchange::RMA || settings.ft || settings.model_kind != ModelKind::Host ||
+      !std::is_same<FieldBufferType, double *>::value) {
+    return false;
+  }
+
+  // Left and right segments hold every field of a column of the chunk at full depth, bottom and top those of a row
+  long lr_len = static_cast<long>(chunk->y) * settings.halo_depth * NUM_FIELDS;
+  long tb_len = static_cast<long>(chunk->x) * settings.halo_depth * NUM_FIELDS;
+  long lengths[NUM_NEIGHBOURS] = {lr_len, lr_len, tb_len, tb_len};
+  long total = 0;
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    rma_halos.lengths[nn] = lengths[nn];
+    rma_halos.own_offsets[nn] = total;
+    total += lengths[nn];
+  }
+  MPI_Win_allocate(total * static_cast<long>(sizeof(double)), sizeof(double), MPI_INFO_NULL, cart_communicator, &rma_halos.segments,
+                   &rma_halos.window);
+  rma_halos.send.resize(total);
+  rma_halos.group_mask = -1;
+  rma_halos.group = MPI_GROUP_NULL;
+  rma_halos.allocated = true;
+
+  // Chunks may differ in size, so every neighbour tells where its segment facing this rank starts
+  int ones[NUM_NEIGHBOURS] = {1, 1, 1, 1}, displs[NUM_NEIGHBOURS] = {0, 1, 2, 3};
+  MPI_Request request;
+  MPI_Ineighbor_alltoallv(rma_halos.own_offsets, ones, displs, MPI_LONG, rma_halos.offsets, ones, displs, MPI_LONG, cart_communicator,
+                          &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  return true;
+}
+
+// Frees the window, collective over the ranks that allocated it
+void finalise_rma_halos() {
+  if (!rma_halos.allocated) return;
+  if (rma_halos.group != MPI_GROUP_NULL) MPI_Group_free(&rma_halos.group);
+  MPI_Win_free(&rma_halos.window);
+  rma_halos = {};
+}
+
+// Lays out the faces of the next one-sided exchange, a count of zero leaving a face out, and returns where each face is packed into
+// and unpacked from, or nullptr for faces left out. Counts never exceed the segments sized for every field at full depth
+void rma_halo_buffers(const int counts[NUM_NEIGHBOURS], double *send_buffers[NUM_NEIGHBOURS], double *recv_buffers[NUM_NEIGHBOURS]) {
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    rma_halos.counts[nn] = counts[nn];
+    send_buffers[nn] = counts[nn] ? &rma_halos.send[rma_halos.own_offsets[nn]] : nullptr;
+    recv_buffers[nn] = counts[nn] ? &rma_halos.segments[rma_halos.own_offsets[nn]] : nullptr;
+  }
+}
+
+// Exposes this rank's segments to the neighbours taking part, waits for theirs and puts the faces laid out by rma_halo_buffers
+// into them, returning before the puts are known to have completed
+void rma_halo_start(Settings &settings) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+
+  int neighbour_ranks[NUM_NEIGHBOURS];
+  get_cart_neighbour_ranks(1, neighbour_ranks);
+  int mask = 0;
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (rma_halos.counts[nn]) mask |= 1 << nn;
+  }
+  if (mask != rma_halos.group_mask) {
+    if (rma_halos.group != MPI_GROUP_NULL) MPI_Group_free(&rma_halos.group);
+    MPI_Group cart_group;
+    MPI_Comm_group(cart_communicator, &cart_group);
+    int ranks[NUM_NEIGHBOURS], num_ranks = 0;
+    for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+      if (mask & (1 << nn)) ranks[num_ranks++] = neighbour_ranks[nn];
+    }
+    MPI_Group_incl(cart_group, num_ranks, ranks, &rma_halos.group);
+    MPI_Group_free(&cart_group);
+    rma_halos.group_mask = mask;
+  }
+
+  // Neighbours exchange the same faces, so the ranks this one puts to are those that put to it
+  MPI_Win_post(rma_halos.group, 0, rma_halos.window);
+  MPI_Win_start(rma_halos.group, 0, rma_halos.window);
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (!rma_halos.counts[nn]) continue;
+    MPI_Put(&rma_halos.send[rma_halos.own_offsets[nn]], rma_halos.counts[nn], MPI_DOUBLE, neighbour_ranks[nn], rma_halos.offsets[nn],
+            rma_halos.counts[nn], MPI_DOUBLE, rma_halos.window);
+  }
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Completes the puts posted by rma_halo_start and waits for the neighbours' puts into this rank's segments
+void rma_halo_wait(Settings &settings) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  MPI_Win_complete(rma_halos.window);
+  MPI_Win_wait(rma_halos.window);
+
+  int neighbour_ranks[NUM_NEIGHBOURS];
+  get_cart_neighbour_ranks(1, neighbour_ranks);
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (rma_halos.counts[nn]) TRACE_MESSAGE(neighbour_ranks[nn], rma_halos.counts[nn]);
+  }
+  comms_seconds += profiler_now() - start;
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
 // Reduce over all ranks to get sum
 void sum_over_ranks(Settings &settings, double *a) {
   START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
   double temp = *a;
-  MPI_Allreduce(&temp, a, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(&temp, a, 1, MPI_DOUBLE, MPI_SUM, world_communicator);
+  comms_seconds += profiler_now() - start;
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
 // Reduce across all ranks to get minimum value
 void min_over_ranks(Settings &settings, double *a) {
   START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  double temp = *a;
+  MPI_Allreduce(&temp, a, 1, MPI_DOUBLE, MPI_MIN, world_communicator);
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Reduce across all ranks to get maximum value
+void max_over_ranks(Settings &settings, double *a) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
   double temp = *a;
-  MPI_Allreduce(&temp, a, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&temp, a, 1, MPI_DOUBLE, MPI_MAX, world_communicator);
+  comms_seconds += profiler_now() - start;
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+// Sums each element of the array over all ranks, in place
+void sum_array_over_ranks(Settings &settings, double *a, int len) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  std::vector<double> temp(a, a + len);
+  MPI_Allreduce(temp.data(), a, len, MPI_DOUBLE, MPI_SUM, world_communicator);
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Gives every rank the master's copy of the text, collective over all ranks
+void broadcast_over_ranks(Settings &settings, std::string &text) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  long len = static_cast<long>(text.size());
+  MPI_Bcast(&len, 1, MPI_LONG, MASTER, world_communicator);
+  text.resize(len);
+  MPI_Bcast(&text[0], static_cast<int>(len), MPI_CHAR, MASTER, world_communicator);
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Sends every rank of the cartesian communicator its slice of the send buffer and receives one from each, counts and
+// displacements in doubles indexed by cartesian rank
+void exchange_over_ranks(Settings &settings, const double *send_buffer, const int send_counts[], const int send_displs[],
+                         double *recv_buffer, const int recv_counts[], const int recv_displs[]) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  MPI_Alltoallv(send_buffer, send_counts, send_displs, MPI_DOUBLE, recv_buffer, recv_counts, recv_displs, MPI_DOUBLE, cart_communicator);
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
+// Seconds this rank has spent communicating so far
+double comms_time() { return comms_seconds; }
+
 // Synchronise all ranks
-void barrier() { MPI_Barrier(MPI_COMM_WORLD); }
+void barrier() { MPI_Barrier(world_communicator); }
 
 // End the application
 void abort_comms() { MPI_Abort(MPI_COMM_WORLD, 1); }
 
-// Initialise a cartesian topology, given the x and y dimensions
-void initialise_cart_topology(int x_dimension, int y_dimension, Settings &settings) {
+// Gives every rank the lowest rank on its node, ranks that can share memory are on the same node
+void get_node_leaders(Settings &settings, int node_leaders[]) {
+  MPI_Comm node_communicator;
+  MPI_Comm_split_type(world_communicator, MPI_COMM_TYPE_SHARED, settings.rank, MPI_INFO_NULL, &node_communicator);
+  int leader = settings.rank;
+  MPI_Allreduce(&settings.rank, &leader, 1, MPI_INT, MPI_MIN, node_communicator);
+  if (node_communicator != world_communicator) {
+    MPI_Comm_free(&node_communicator);
+  }
+  node_leaders[settings.rank] = leader;
+  MPI_Allgather(&leader, 1, MPI_INT, node_leaders, 1, MPI_INT, world_communicator);
+}
+
+// Initialise a cartesian topology, given the x and y dimensions, with every rank at its row-major position in cart_positions,
+// or in rank order without it
+void initialise_cart_topology(int x_dimension, int y_dimension, Settings &settings, const int cart_positions[]) {
+  // Ranks of a split communicator are ordered by key, which the cartesian communicator keeps as it does not reorder
+  MPI_Comm ordered_communicator = world_communicator;
+  if (cart_positions) {
+    MPI_Comm_split(world_communicator, 0, cart_positions[settings.rank], &ordered_communicator);
+  }
+
   int dims[NUM_GRID_DIMENSIONS] = {x_dimension, y_dimension};
   int periods[NUM_GRID_DIMENSIONS] = {false, false};
   int reorder = false;
-  MPI_Cart_create(MPI_COMM_WORLD, NUM_GRID_DIMENSIONS, dims, periods, reorder, &cart_communicator);
+  MPI_Cart_create(ordered_communicator, NUM_GRID_DIMENSIONS, dims, periods, reorder, &cart_communicator);
+  if (ordered_communicator != world_communicator) {
+    MPI_Comm_free(&ordered_communicator);
+  }
 
   MPI_Comm_rank(cart_communicator, &settings.cart_rank);
 
@@ -79,4 +541,116 @@ void get_cart_neighbour_ranks(int offset, int neighbour_ranks[]) {
   MPI_Cart_shift(cart_communicator, Y_AXIS, offset, &neighbour_ranks[DOWN], &neighbour_ranks[UP]);
 }
 
-void get_cart_coords(int cart_rank, int cart_coords[]) { MPI_Cart_coords(cart_communicator, cart_rank, NUM_GRID_DIMENSIONS, cart_coords); }
\ No newline at end of file
+void get_cart_coords(int cart_rank, int cart_coords[]) { MPI_Cart_coords(cart_communicator, cart_rank, NUM_GRID_DIMENSIONS, cart_coords); }
+
+// Ranks in the world communicator of the first num_ranks cartesian ranks, which node-aware mapping reorders
+void get_cart_world_ranks(int num_ranks, int world_ranks[]) {
+  std::vector<int> cart_ranks(num_ranks);
+  std::iota(cart_ranks.begin(), cart_ranks.end(), 0);
+  MPI_Group cart_group, world_group;
+  MPI_Comm_group(cart_communicator, &cart_group);
+  MPI_Comm_group(world_communicator, &world_group);
+  MPI_Group_translate_ranks(cart_group, num_ranks, cart_ranks.data(), world_group, world_ranks);
+  MPI_Group_free(&cart_group);
+  MPI_Group_free(&world_group);
+}
+
+// The face of the neighbour that faces this one
+static int opposite_face(int face) { return face ^ 1; }
+
+static double *shared_halo_buffer(SharedHaloHeader *header, int face) {
+  return reinterpret_cast<double *>(reinterpret_cast<char *>(header) + header->offsets[face]);
+}
+
+// Gives every face with a neighbour on this node a buffer in a shared-memory window, collective over the ranks of the cartesian
+// communicator, and returns the number of such faces. Shared segments are host memory, so only models whose field buffers are host
+// pointers take part, and fault tolerance keeps every message on MPI to recover from failed neighbours
+int initialise_shared_halos(Settings &settings, const Chunk *chunk) {
+  finalise_shared_halos();
+  if (!settings.shared_halos || settings.ft || settings.model_kind != ModelKind::Host || !std::is_same<FieldBufferType, double *>::value) {
+    return 0;
+  }
+
+  MPI_Comm_split_type(cart_communicator, MPI_COMM_TYPE_SHARED, settings.cart_rank, MPI_INFO_NULL, &shared_halos.node_communicator);
+  int node_size;
+  MPI_Comm_size(shared_halos.node_communicator, &node_size);
+  std::vector<int> node_cart_ranks(node_size);
+  MPI_Allgather(&settings.cart_rank, 1, MPI_INT, node_cart_ranks.data(), 1, MPI_INT, shared_halos.node_communicator);
+
+  // Left and right buffers hold every field of a column of the chunk at full depth, bottom and top those of a row
+  long lr_len = static_cast<long>(chunk->y) * settings.halo_depth * NUM_FIELDS;
+  long tb_len = static_cast<long>(chunk->x) * settings.halo_depth * NUM_FIELDS;
+  long header_bytes = (sizeof(SharedHaloHeader) + 63) / 64 * 64;
+  long lengths[NUM_NEIGHBOURS] = {lr_len, lr_len, tb_len, tb_len};
+  long bytes = header_bytes;
+  for (long length : lengths) {
+    bytes += length * static_cast<long>(sizeof(double));
+  }
+
+  MPI_Win_allocate_shared(bytes, 1, MPI_INFO_NULL, shared_halos.node_communicator, &shared_halos.own, &shared_halos.window);
+  new (shared_halos.own) SharedHaloHeader{};
+  long offset = header_bytes;
+  for (int face = 0; face < NUM_NEIGHBOURS; ++face) {
+    shared_halos.own->offsets[face] = offset;
+    offset += lengths[face] * static_cast<long>(sizeof(double));
+    shared_halos.generation[face] = 0;
+  }
+  shared_halos.allocated = true;
+  MPI_Barrier(shared_halos.node_communicator);
+
+  int neighbour_ranks[NUM_NEIGHBOURS], shared_faces = 0;
+  get_cart_neighbour_ranks(1, neighbour_ranks);
+  for (int face = 0; face < NUM_NEIGHBOURS; ++face) {
+    shared_halos.neighbours[face] = nullptr;
+    for (int nn = 0; nn < node_size; ++nn) {
+      if (neighbour_ranks[face] == MPI_PROC_NULL || node_cart_ranks[nn] != neighbour_ranks[face]) continue;
+      MPI_Aint size;
+      int disp_unit;
+      MPI_Win_shared_query(shared_halos.window, nn, &size, &disp_unit, &shared_halos.neighbours[face]);
+      ++shared_faces;
+    }
+  }
+  return shared_faces;
+}
+
+// Frees the shared-memory window, collective over the ranks that allocated it
+void finalise_shared_halos() {
+  if (!shared_halos.allocated) return;
+  MPI_Win_free(&shared_halos.window);
+  MPI_Comm_free(&shared_halos.node_communicator);
+  shared_halos = {};
+}
+
+// The buffer this rank packs the face into for its neighbour to read in place, or nullptr when the neighbour is not on this node.
+// Waits until the neighbour has read the previous exchange
+double *shared_halo_send_buffer(Settings &settings, int face) {
+  if (!shared_halos.allocated || !shared_halos.neighbours[face]) return nullptr;
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  long generation = ++shared_halos.generation[face];
+  while (shared_halos.neighbours[face]->released[opposite_face(face)].load(std::memory_order_acquire) < generation - 1) {
+    std::this_thread::yield();
+  }
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+  return shared_halo_buffer(shared_halos.own, face);
+}
+
+// Publishes the face packed into its shared buffer
+void shared_halo_post(int face) { shared_halos.own->posted[face].store(shared_halos.generation[face], std::memory_order_release); }
+
+// Waits for the neighbour across the face to post this exchange and returns the buffer it packed
+double *shared_halo_recv_buffer(Settings &settings, int face) {
+  START_PROFILING(settings.kernel_profile);
+  double start = profiler_now();
+  SharedHaloHeader *neighbour = shared_halos.neighbours[face];
+  while (neighbour->posted[opposite_face(face)].load(std::memory_order_acquire) < shared_halos.generation[face]) {
+    std::this_thread::yield();
+  }
+  comms_seconds += profiler_now() - start;
+  STOP_PROFILING(settings.kernel_profile, __func__);
+  return shared_halo_buffer(neighbour, opposite_face(face));
+}
+
+// Tells the neighbour across the face that its buffer has been read and may be packed again
+void shared_halo_release(int face) { shared_halos.own->released[face].store(shared_halos.generation[face], std::memory_order_release); }
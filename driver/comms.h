@@ -1,6 +1,8 @@
 #pragma once
 
-#ifndef NO_MPI
+#if defined(MPI_THREADS)
+  #include "mpi_threads.h"
+#elif !defined(NO_MPI)
   // XXX OpenMPI pulls in CXX headers which we don't link against, prevent that:
   #define OMPI_SKIP_MPICXX
   #include <mpi.h>
@@ -24,11 +26,39 @@ void abort_comms();
 void finalise_comms();
 void initialise_comms(int argc, char **argv);
 void initialise_ranks(Settings &settings);
+void split_comms(Settings &settings, int group);
+void merge_comms(Settings &settings);
 void sum_over_ranks(Settings &settings, double *a);
 void min_over_ranks(Settings &settings, double *a);
+void max_over_ranks(Settings &settings, double *a);
+void sum_array_over_ranks(Settings &settings, double *a, int len);
+void broadcast_over_ranks(Settings &settings, std::string &text);
+void exchange_over_ranks(Settings &settings, const double *send_buffer, const int send_counts[], const int send_displs[],
+                         double *recv_buffer, const int recv_counts[], const int recv_displs[]);
+double comms_time();
 void send_recv_message(Settings &settings, double *send_buffer, double *recv_buffer, int buffer_len,
                        int neighbour_rank, int send_tag, int recv_tag);
+void send_recv_halo_fields(Settings &settings, double *const fields[NUM_FIELDS], int x, int y, int face, int depth, int buffer_len,
+                           int neighbour_rank, int send_tag, int recv_tag);
+void finalise_halo_datatypes();
+void neighbour_halo_buffers(const int counts[NUM_NEIGHBOURS], double *send_buffers[NUM_NEIGHBOURS], double *recv_buffers[NUM_NEIGHBOURS]);
+void neighbour_halo_start(Settings &settings);
+void neighbour_halo_wait(Settings &settings);
+bool initialise_rma_halos(Settings &settings, const Chunk *chunk);
+void finalise_rma_halos();
+void rma_halo_buffers(const int counts[NUM_NEIGHBOURS], double *send_buffers[NUM_NEIGHBOURS], double *recv_buffers[NUM_NEIGHBOURS]);
+void rma_halo_start(Settings &settings);
+void rma_halo_wait(Settings &settings);
 
-void initialise_cart_topology(int x_dimension, int y_dimension, Settings &settings);
+void get_node_leaders(Settings &settings, int node_leaders[]);
+void initialise_cart_topology(int x_dimension, int y_dimension, Settings &settings, const int cart_positions[]);
 void get_cart_neighbour_ranks(int offset, int neighbours_rank[]);
-void get_cart_coords(int cart_rank, int cart_coords[]);
\ No newline at end of file
+void get_cart_coords(int cart_rank, int cart_coords[]);
+void get_cart_world_ranks(int num_ranks, int world_ranks[]);
+
+int initialise_shared_halos(Settings &settings, const Chunk *chunk);
+void finalise_shared_halos();
+double *shared_halo_send_buffer(Settings &settings, int face);
+void shared_halo_post(int face);
+double *shared_halo_recv_buffer(Settings &settings, int face);
+void shared_halo_release(int face);
\ No newline at end of file
@@ -1,13 +1,21 @@
 #include "application.h"
 #include "comms.h"
 #include "drivers.h"
+#include "rebalance.h"
+#include "run_report.h"
 #include "vtk_visitor.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 #include <signal.h>
 
 double calc_dt(Chunk *chunks);
 void calc_min_timestep(Chunk *chunks, double *dt, int chunks_per_task);
+void calc_next_timestep(Chunk *chunks, Settings &settings, double dt);
+
+// Relative slack on the last step, so that rounding in the accumulated time never leaves a vanishing step before end_time
+#define END_TIME_TOLERANCE 1.0e-9
 void solve(Chunk *chunks, Settings &settings, int tt, double *wallclock_prev);
 
 // The main timestep loop
@@ -17,35 +25,53 @@ bool diffuse(Chunk *chunks, Settings &settings) {
 
   if (settings.visit_frequency) visit(tt, chunks, settings);
 
-  for (tt = 1; tt <= settings.end_step; ++tt) {
+  // Compute time is the wallclock of the steps less the time spent communicating
+  double start = profiler_now();
+  double start_comms = comms_time();
+
+  for (tt = 1; tt <= settings.end_step && settings.sim_time < settings.end_time; ++tt) {
     // Inject failure at given step on given coords
     if (settings.ft                                                                                                           //
         && settings.cart_coords[X_AXIS] == settings.with_ft_kill_x && settings.cart_coords[Y_AXIS] == settings.with_ft_kill_y //
         && tt == settings.with_ft_kill_iter) {
       std::cout << "XXX - rank:" << settings.rank << " - cart-rank:" << settings.cart_rank << " - cart-coords:("
                 << settings.cart_coords[X_AXIS] << "," << settings.cart_coords[Y_AXIS] << ")" << std::endl;
+      flush_log(settings);
       raise(SIGKILL);
     }
 
     solve(chunks, settings, tt, &wallclock_prev);
+
+    if (tt == settings.rebalance_steps) {
+      rebalance(chunks, settings, profiler_now() - start - (comms_time() - start_comms));
+    }
   }
 
   if (settings.visit_frequency) visit(tt, chunks, settings);
+
+  print_and_log(settings, "\n Simulated %d steps to time %.6e, stopped by %s\n", settings.sim_steps, settings.sim_time,
+                settings.sim_time < settings.end_time ? "end_step" : "end_time");
   return field_summary_driver(chunks, settings, true);
 }
 
 // Performs a solve for a single timestep
 void solve(Chunk *chunks, Settings &settings, int tt, double *wallclock_prev) {
-  print_and_log(settings, "\n Timestep %d\n", tt);
+  print_and_log_at(settings, LOG_STEP, "\n Timestep %d\n", tt);
   profiler_start_timer(settings.wallclock_profile);
 
   // Calculate minimum timestep information
-  double dt = settings.dt_init;
+  double dt = DBL_MAX;
   calc_min_timestep(chunks, &dt, settings.num_chunks_per_rank);
 
   // Pick the smallest timestep across all ranks
   min_over_ranks(settings, &dt);
 
+  // The last step ends exactly on end_time
+  bool is_last_step = settings.end_time - settings.sim_time <= dt * (1.0 + END_TIME_TOLERANCE);
+  if (is_last_step) {
+    dt = settings.end_time - settings.sim_time;
+  }
+
   double rx = dt / (settings.dx * settings.dx);
   double ry = dt / (settings.dy * settings.dy);
 
@@ -68,19 +94,32 @@ void solve(Chunk *chunks, Settings &settings, int tt, double *wallclock_prev) {
   // Perform solve finalisation tasks
   solve_finished_driver(chunks, settings);
 
+  settings.sim_time = is_last_step ? settings.end_time : settings.sim_time + dt;
+  settings.sim_steps++;
+  if (settings.adaptive_timestep) {
+    calc_next_timestep(chunks, settings, dt);
+  }
+
   if (tt % settings.summary_frequency == 0) {
     field_summary_driver(chunks, settings, false);
   }
-  if (tt % settings.visit_frequency == 0) {
+  if (settings.visit_frequency && tt % settings.visit_frequency == 0) {
     visit(tt, chunks, settings);
   }
 
   profiler_end_timer(settings.wallclock_profile, "Wallclock");
 
-  double wallclock = settings.wallclock_profile->profiler_entries[0].time;
-  print_and_log(settings, " Wallclock: \t\t%.3lfs\n", wallclock);
-  print_and_log(settings, " Avg. time per cell: \t%.6e\n", (wallclock - *wallclock_prev) / (settings.grid_x_cells * settings.grid_y_cells));
-  print_and_log(settings, " Error: \t\t%.6e\n", error);
+  double wallclock = profiler_get_time(settings.wallclock_profile, "Wallclock");
+  print_and_log_at(settings, LOG_STEP, " Wallclock: \t\t%.3lfs\n", wallclock);
+  print_and_log_at(settings, LOG_DETAIL, " Avg. time per cell: \t%.6e\n",
+                   (wallclock - *wallclock_prev) / (settings.grid_x_cells * settings.grid_y_cells));
+  print_and_log_at(settings, LOG_STEP, " Error: \t\t%.6e\n", error);
+  if (settings.adaptive_timestep) {
+    print_and_log_at(settings, LOG_STEP, " dt: \t\t\t%.6e (time %.6e)\n", dt, settings.sim_time);
+  }
+
+  run_report_step(settings, tt, dt, error, wallclock - *wallclock_prev);
+  *wallclock_prev = wallclock;
 }
 
 // Calculate minimum timestep
@@ -96,6 +135,26 @@ void calc_min_timestep(Chunk *chunks, double *dt, int chunks_per_task) {
 
 // Calculates a value for dt
 double calc_dt(Chunk *chunk) {
-  // Currently defaults to config provided value
-  return chunk->dt_init;
+  // The config provided value, unless adapted since
+  return chunk->dt;
+}
+
+// Scales the next timestep by how far the last solve was from the target iteration count. CG iterations grow roughly
+// with the square root of dt, so the square of the ratio keeps the count near the target as the solution smooths.
+void calc_next_timestep(Chunk *chunks, Settings &settings, double dt) {
+  int iterations = std::max(1, settings.solve_iterations);
+
+  // Without a target, the first solve at dt_init sets it
+  if (settings.timestep_target_iterations <= 0) {
+    settings.timestep_target_iterations = iterations;
+  }
+
+  double ratio = static_cast<double>(settings.timestep_target_iterations) / iterations;
+  double next_dt = dt * std::clamp(ratio * ratio, DEF_TIMESTEP_MAX_SHRINK, DEF_TIMESTEP_MAX_GROWTH);
+  if (settings.timestep_min > 0.0) next_dt = std::max(next_dt, settings.timestep_min);
+  if (settings.timestep_max > 0.0) next_dt = std::min(next_dt, settings.timestep_max);
+
+  for (int cc = 0; cc < settings.num_chunks_per_rank; ++cc) {
+    chunks[cc].dt = next_dt;
+  }
 }
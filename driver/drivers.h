@@ -11,6 +11,8 @@ void kernel_finalise_driver(Chunk *chunks, Settings &settings);
 // Halo drivers
 void halo_update_driver(Chunk *chunks, Settings &settings, int depth);
 void remote_halo_driver(Chunk *chunks, Settings &settings, int depth);
+void remote_halo_start(Chunk *chunks, Settings &settings, int depth);
+void remote_halo_finish(Chunk *chunks, Settings &settings);
 
 // Conjugate Gradient solver drivers
 void cg_driver(Chunk *chunks, Settings &settings, double rx, double ry, double *error);
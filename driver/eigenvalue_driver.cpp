@@ -51,7 +51,7 @@ void eigenvalue_driver_initialise(Chunk *chunks, Settings &settings, int num_cg_
     chunks[cc].eigmin *= 0.95;
     chunks[cc].eigmax *= 1.05;
 
-    print_and_log(settings, "Min. eigenvalue: \t%.12e\nMax. eigenvalue: \t%.12e\n", chunks[cc].eigmin, chunks[cc].eigmax);
+    print_and_log_at(settings, LOG_DETAIL, "Min. eigenvalue: \t%.12e\nMax. eigenvalue: \t%.12e\n", chunks[cc].eigmin, chunks[cc].eigmax);
   }
 
   STOP_PROFILING(settings.kernel_profile, __func__);
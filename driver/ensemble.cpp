@@ -0,0 +1,344 @@
+#include "ensemble.h"
+#include "application.h"
+#include "comms.h"
+#include "drivers.h"
+#include "kernel_interface.h"
+#include "run_report.h"
+#include "vtk_writer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A deck with some of its settings replaced
+struct EnsembleCase {
+  std::string deck;
+  std::string overrides;
+  std::string label;
+};
+
+// Outcome of a case, as filled in by the master of the group that ran it
+enum EnsembleResult {
+  RESULT_GROUP,
+  RESULT_RANKS,
+  RESULT_X_CELLS,
+  RESULT_Y_CELLS,
+  RESULT_REUSED,
+  RESULT_STEPS,
+  RESULT_TIME,
+  RESULT_ITERATIONS,
+  RESULT_WALLCLOCK,
+  RESULT_TEMPERATURE,
+  RESULT_CHECKED,
+  RESULT_PASSED,
+  NUM_ENSEMBLE_RESULTS
+};
+
+// Chunks kept from the previous case of a group, with everything their allocation depends on
+struct EnsembleAllocation {
+  Chunk *chunks;
+  int x_cells;
+  int y_cells;
+  int halo_depth;
+  int max_iters;
+  int num_chunks_per_rank;
+
+  // The decomposition that came with them
+  int num_chunks;
+  int grid_x_chunks;
+  int grid_y_chunks;
+  int cart_rank;
+  int *cart_coords;
+
+  // Load balancing resized the chunks away from the even split
+  bool rebalanced;
+};
+
+// Each line holds a deck followed by 'key=value' overrides and flags, where a comma separated list of values expands into one case
+// each
+static std::vector<EnsembleCase> ensemble_cases(const char *filename) {
+  FILE *fp = std::fopen(filename, "r");
+  if (!fp) {
+    die(__LINE__, __FILE__, "Could not open ensemble file %s\n", filename);
+  }
+
+  std::vector<EnsembleCase> cases;
+  size_t len = 0;
+  char *line = nullptr;
+  while (getline(&line, &len, fp) != EOF) {
+    std::stringstream tokens(line);
+    std::string deck;
+    if (!(tokens >> deck) || deck[0] == '#') continue;
+
+    std::vector<EnsembleCase> line_cases{{deck, "", ""}};
+    std::string token;
+    while (tokens >> token) {
+      // Flags such as use_cg take no value
+      size_t equals = token.find('=');
+      if (equals == std::string::npos) {
+        for (EnsembleCase &line_case : line_cases) {
+          line_case.overrides += token + "\n";
+          line_case.label += (line_case.label.empty() ? "" : " ") + token;
+        }
+        continue;
+      }
+      if (equals == 0) {
+        die(__LINE__, __FILE__, "Expected 'key=value' or a flag in ensemble file %s, got '%s'\n", filename, token.c_str());
+      }
+      std::string key = token.substr(0, equals);
+
+      std::vector<EnsembleCase> expanded;
+      std::stringstream values(token.substr(equals + 1));
+      std::string value;
+      while (std::getline(values, value, ',')) {
+        for (const EnsembleCase &line_case : line_cases) {
+          EnsembleCase expanded_case = line_case;
+          expanded_case.overrides += key + "=" + value + "\n";
+          expanded_case.label += (expanded_case.label.empty() ? "" : " ") + key + "=" + value;
+          expanded.push_back(expanded_case);
+        }
+      }
+      line_cases = expanded;
+    }
+    cases.insert(cases.end(), line_cases.begin(), line_cases.end());
+  }
+  std::free(line);
+  std::fclose(fp);
+
+  if (cases.empty()) {
+    die(__LINE__, __FILE__, "No cases in ensemble file %s\n", filename);
+  }
+  return cases;
+}
+
+// Numbers a per-case file before its extension, target/tea.out becoming target/tea.3.out
+static std::string case_filename(const char *filename, size_t index) {
+  std::string name(filename);
+  size_t slash = name.find_last_of('/');
+  size_t dot = name.find_last_of('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return name + "." + std::to_string(index);
+  }
+  return name.substr(0, dot) + "." + std::to_string(index) + name.substr(dot);
+}
+
+static void ensemble_release(EnsembleAllocation &allocation, Settings &settings) {
+  if (!allocation.chunks) return;
+
+  int num_chunks_per_rank = settings.num_chunks_per_rank;
+  settings.num_chunks_per_rank = allocation.num_chunks_per_rank;
+  kernel_finalise_driver(allocation.chunks, settings);
+  for (int cc = 0; cc < allocation.num_chunks_per_rank; ++cc) {
+    finalise_chunk(&(allocation.chunks[cc]));
+  }
+  settings.num_chunks_per_rank = num_chunks_per_rank;
+
+  std::free(allocation.chunks);
+  std::free(allocation.cart_coords);
+  allocation = {};
+}
+
+// Allocates the chunks for the case, unless those of the previous case fit its grid
+static bool ensemble_allocate(EnsembleAllocation &allocation, Settings &settings, State *states) {
+  bool reusable = allocation.chunks && allocation.x_cells == settings.grid_x_cells && allocation.y_cells == settings.grid_y_cells &&
+                  allocation.halo_depth == settings.halo_depth && allocation.max_iters == settings.max_iters &&
+                  allocation.num_chunks_per_rank == settings.num_chunks_per_rank && !allocation.rebalanced;
+
+  if (reusable) {
+    settings.num_chunks = allocation.num_chunks;
+    settings.grid_x_chunks = allocation.grid_x_chunks;
+    settings.grid_y_chunks = allocation.grid_y_chunks;
+    settings.cart_rank = allocation.cart_rank;
+    settings.cart_coords = allocation.cart_coords;
+    initialise_halo_exchange(allocation.chunks, settings);
+    initialise_fields(allocation.chunks, settings, states);
+    return true;
+  }
+
+  // Models that cannot initialise their kernels twice run every case of a group on the chunks of its first
+  if (allocation.chunks && !settings.model_reinitialisable) {
+    die(__LINE__, __FILE__,
+        "%s cannot reinitialise its kernels, so every case of an ensemble group must keep the grid, halo depth, max_iters and "
+        "chunks per rank of its first case\n",
+        settings.model_name.c_str());
+  }
+  ensemble_release(allocation, settings);
+  initialise_application(&allocation.chunks, settings, states);
+  allocation.x_cells = settings.grid_x_cells;
+  allocation.y_cells = settings.grid_y_cells;
+  allocation.halo_depth = settings.halo_depth;
+  allocation.max_iters = settings.max_iters;
+  allocation.num_chunks_per_rank = settings.num_chunks_per_rank;
+  allocation.num_chunks = settings.num_chunks;
+  allocation.grid_x_chunks = settings.grid_x_chunks;
+  allocation.grid_y_chunks = settings.grid_y_chunks;
+  allocation.cart_rank = settings.cart_rank;
+  allocation.cart_coords = settings.cart_coords;
+  return false;
+}
+
+// Runs one case on the ranks of a group, collective over the group
+static void ensemble_run_case(const Settings &group_settings, const EnsembleCase &ensemble_case, size_t index, int group,
+                              EnsembleAllocation &allocation, double *result) {
+  Settings settings = group_settings;
+
+  // Each case parses its own deck into its own copies of the settings strings
+  std::string deck = ensemble_case.deck;
+  std::string log_filename = case_filename(group_settings.tea_out_filename, index);
+  std::string report_filename = case_filename(group_settings.tea_report_filename, index);
+  char solver_name[64];
+  std::strncpy(solver_name, group_settings.solver_name, sizeof(solver_name) - 1);
+  solver_name[sizeof(solver_name) - 1] = '\0';
+  settings.tea_in_filename = &deck[0];
+  settings.tea_out_filename = &log_filename[0];
+  settings.tea_report_filename = &report_filename[0];
+  settings.solver_name = solver_name;
+
+  // Concurrent groups would interleave on stdout, so cases only log to their own file
+  settings.log_stdout = false;
+  settings.tea_out_fp = nullptr;
+  if (settings.rank == MASTER) {
+    settings.tea_out_fp = std::fopen(settings.tea_out_filename, "w");
+    if (!settings.tea_out_fp) {
+      die(__LINE__, __FILE__, "Could not open log %s\n", settings.tea_out_filename);
+    }
+  }
+
+  settings.kernel_profile = profiler_initialise();
+  settings.application_profile = profiler_initialise();
+  settings.wallclock_profile = profiler_initialise();
+  settings.sim_time = 0.0;
+  settings.sim_steps = 0;
+  run_report_reset();
+
+  State *states{};
+  read_config_overrides(settings, &states, ensemble_case.overrides.c_str());
+  print_and_log(settings, "Ensemble case %zu: %s %s\n", index, ensemble_case.deck.c_str(), ensemble_case.label.c_str());
+
+  // Every case would dump to the same VTK files, and groups would write them concurrently
+  if (settings.visit_frequency) {
+    print_and_log(settings, "Warning: ensemble cases do not write VTK dumps, ignoring visit_frequency\n");
+    settings.visit_frequency = 0;
+  }
+
+  bool reused = ensemble_allocate(allocation, settings, states);
+
+  barrier();
+  double start = profiler_now();
+#ifndef DIFFUSE_OVERLOAD
+  bool valid = diffuse(allocation.chunks, settings);
+#else
+  bool valid = diffuse_overload(allocation.chunks, settings);
+#endif
+  vtk_writer_finalise();
+  allocation.rebalanced = !settings.chunk_x_edges.empty();
+  double wallclock = profiler_now() - start;
+  max_over_ranks(settings, &wallclock);
+
+  if (settings.rank == MASTER) {
+    run_report_write(settings, valid);
+
+    RunReportTotals totals = run_report_totals();
+    result[RESULT_GROUP] = group;
+    result[RESULT_RANKS] = settings.num_ranks;
+    result[RESULT_X_CELLS] = settings.grid_x_cells;
+    result[RESULT_Y_CELLS] = settings.grid_y_cells;
+    result[RESULT_REUSED] = reused;
+    result[RESULT_STEPS] = settings.sim_steps;
+    result[RESULT_TIME] = settings.sim_time;
+    result[RESULT_ITERATIONS] = static_cast<double>(totals.iterations);
+    result[RESULT_WALLCLOCK] = wallclock;
+    result[RESULT_TEMPERATURE] = totals.temperature;
+    result[RESULT_CHECKED] = totals.checked;
+    result[RESULT_PASSED] = totals.passed;
+  }
+
+  finalise_log(settings);
+  profiler_finalise(&settings.kernel_profile);
+  profiler_finalise(&settings.application_profile);
+  profiler_finalise(&settings.wallclock_profile);
+  std::free(states);
+}
+
+static void ensemble_write(Settings &settings, const std::vector<EnsembleCase> &cases, const std::vector<double> &results, int groups) {
+  FILE *fp = std::fopen(settings.ensemble_output_filename, "w");
+  if (!fp) {
+    die(__LINE__, __FILE__, "Could not open ensemble output file %s\n", settings.ensemble_output_filename);
+  }
+
+  std::fprintf(fp, "{\n  \"model\": \"%s\",\n  \"ranks\": %d,\n  \"groups\": %d,\n", settings.model_name.c_str(), settings.num_ranks,
+               groups);
+  std::fprintf(fp, "  \"cases\": [");
+  for (size_t cc = 0; cc < cases.size(); ++cc) {
+    const double *result = &results[cc * NUM_ENSEMBLE_RESULTS];
+    std::fprintf(fp, "%s\n    {\n", cc ? "," : "");
+    std::fprintf(fp, "      \"case\": %zu,\n      \"deck\": \"%s\",\n      \"overrides\": \"%s\",\n", cc, cases[cc].deck.c_str(),
+                 cases[cc].label.c_str());
+    std::fprintf(fp, "      \"log\": \"%s\",\n", case_filename(settings.tea_out_filename, cc).c_str());
+    std::fprintf(fp, "      \"report\": \"%s\",\n", case_filename(settings.tea_report_filename, cc).c_str());
+    std::fprintf(fp, "      \"group\": %d,\n      \"ranks\": %d,\n", static_cast<int>(result[RESULT_GROUP]),
+                 static_cast<int>(result[RESULT_RANKS]));
+    std::fprintf(fp, "      \"x_cells\": %d,\n      \"y_cells\": %d,\n", static_cast<int>(result[RESULT_X_CELLS]),
+                 static_cast<int>(result[RESULT_Y_CELLS]));
+    std::fprintf(fp, "      \"reused\": %s,\n", result[RESULT_REUSED] ? "true" : "false");
+    std::fprintf(fp, "      \"steps\": %d,\n      \"time\": %.15e,\n", static_cast<int>(result[RESULT_STEPS]), result[RESULT_TIME]);
+    std::fprintf(fp, "      \"iterations\": %ld,\n", static_cast<long>(result[RESULT_ITERATIONS]));
+    std::fprintf(fp, "      \"wallclock\": %.9e,\n      \"temperature\": %.15e,\n", result[RESULT_WALLCLOCK], result[RESULT_TEMPERATURE]);
+    std::fprintf(fp, "      \"checked\": %s,\n      \"passed\": %s\n    }", result[RESULT_CHECKED] ? "true" : "false",
+                 result[RESULT_PASSED] ? "true" : "false");
+  }
+  std::fprintf(fp, "\n  ]\n}\n");
+  std::fclose(fp);
+}
+
+bool ensemble(Settings &settings) {
+  std::vector<EnsembleCase> cases = ensemble_cases(settings.ensemble_filename);
+
+  // Groups are contiguous blocks of ranks, taking the cases in turn
+  int groups = std::max(1, std::min({settings.ensemble_groups, settings.num_ranks, static_cast<int>(cases.size())}));
+  int group = settings.rank * groups / settings.num_ranks;
+
+  print_and_log(settings, "Ensemble:\n");
+  print_and_log(settings, " - File:   %s\n", settings.ensemble_filename);
+  print_and_log(settings, " - Cases:  %zu\n", cases.size());
+  print_and_log(settings, " - Groups: %d over %d ranks\n", groups, settings.num_ranks);
+  print_and_log(settings, " - Output: %s\n", settings.ensemble_output_filename);
+  flush_log(settings);
+
+  Settings group_settings = settings;
+  split_comms(group_settings, group);
+
+  std::vector<double> results(cases.size() * NUM_ENSEMBLE_RESULTS, 0.0);
+  EnsembleAllocation allocation{};
+  for (size_t cc = group; cc < cases.size(); cc += groups) {
+    ensemble_run_case(group_settings, cases[cc], cc, group, allocation, &results[cc * NUM_ENSEMBLE_RESULTS]);
+  }
+  ensemble_release(allocation, group_settings);
+  merge_comms(group_settings);
+
+  // Only the master of the group that ran a case filled it in
+  std::vector<double> all_results(results.size(), 0.0);
+  MPI_Reduce(results.data(), all_results.data(), static_cast<int>(results.size()), MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
+
+  bool valid = true;
+  print_and_log(settings, "\n %6s%7s%7s%12s%8s%8s%12s%16s%24s%8s  %s\n", "Case", "Group", "Ranks", "Grid", "Reused", "Steps", "Iterations",
+                "Wallclock (s)", "Temperature", "Check", "Deck");
+  for (size_t cc = 0; cc < cases.size(); ++cc) {
+    const double *result = &all_results[cc * NUM_ENSEMBLE_RESULTS];
+    std::string grid =
+        std::to_string(static_cast<int>(result[RESULT_X_CELLS])) + "x" + std::to_string(static_cast<int>(result[RESULT_Y_CELLS]));
+    const char *check = !result[RESULT_CHECKED] ? "-" : result[RESULT_PASSED] ? "PASSED" : "FAILED";
+    valid = valid && (!result[RESULT_CHECKED] || result[RESULT_PASSED]);
+    print_and_log(settings, " %6zu%7d%7d%12s%8s%8d%12ld%16.3F%24.15e%8s  %s %s\n", cc, static_cast<int>(result[RESULT_GROUP]),
+                  static_cast<int>(result[RESULT_RANKS]), grid.c_str(), result[RESULT_REUSED] ? "yes" : "no",
+                  static_cast<int>(result[RESULT_STEPS]), static_cast<long>(result[RESULT_ITERATIONS]), result[RESULT_WALLCLOCK],
+                  result[RESULT_TEMPERATURE], check, cases[cc].deck.c_str(), cases[cc].label.c_str());
+  }
+
+  if (settings.rank == MASTER) {
+    ensemble_write(settings, cases, all_results, groups);
+  }
+  return valid;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "settings.h"
+
+/*
+ *		ENSEMBLE
+ *		Runs a list of decks, each optionally with some of its settings overridden by one or more values,
+ *		in a single launch. Cases run back to back, or concurrently on disjoint groups of ranks, reusing
+ *		the chunk allocations of the previous case of the group whenever the grid matches. Every case
+ *		writes its own log and run report, and the master collects the outcome of all of them as JSON.
+ */
+
+#define DEF_ENSEMBLE_GROUPS 1
+#define DEF_ENSEMBLE_OUTPUT_FILENAME "target/ensemble.json"
+
+// Runs every case of the ensemble in place of the normal solve, collective over all ranks.
+// Returns whether every checked case passed, on the master only.
+bool ensemble(Settings &settings);
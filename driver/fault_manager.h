@@ -1,6 +1,8 @@
 #pragma once
 
-#ifndef NO_MPI
+#if defined(MPI_THREADS)
+  #include "mpi_threads.h"
+#elif !defined(NO_MPI)
   // XXX OpenMPI pulls in CXX headers which we don't link against, prevent that:
   #define OMPI_SKIP_MPICXX
   #include <mpi.h>
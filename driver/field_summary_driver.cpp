@@ -1,6 +1,8 @@
 #include "chunk.h"
 #include "comms.h"
 #include "kernel_interface.h"
+#include "run_report.h"
+#include <vector>
 
 void get_checking_value(Settings &settings, double *checking_value);
 
@@ -24,6 +26,13 @@ bool field_summary_driver(Chunk *chunks, Settings &settings, bool is_solve_finis
   sum_over_ranks(settings, &ie);
   sum_over_ranks(settings, &temp);
 
+  if (settings.rank == MASTER && is_solve_finished) {
+    run_report_summary(vol, mass, ie, temp);
+  }
+
+  // Summaries are where the buffered log of the preceding timesteps is written out
+  flush_log(settings);
+
   if (settings.rank == MASTER && settings.check_result && is_solve_finished) {
     print_and_log(settings, "\n Checking results...\n");
 
@@ -34,7 +43,9 @@ bool field_summary_driver(Chunk *chunks, Settings &settings, bool is_solve_finis
     print_and_log(settings, " Actual   %.15e\n", temp);
 
     double qa_diff = fabs(100.0 * (temp / checking_value) - 100.0);
-    if (qa_diff < 0.001 && !std::isnan(temp)) {
+    bool passed = qa_diff < 0.001 && !std::isnan(temp);
+    run_report_check(checking_value, qa_diff, passed);
+    if (passed) {
       print_and_log(settings, " This run PASSED (Difference is within %.8lf%%)\n", qa_diff);
       return true;
     } else {
@@ -46,35 +57,55 @@ bool field_summary_driver(Chunk *chunks, Settings &settings, bool is_solve_finis
   return true;
 }
 
-// Fetches the checking value from the test problems file
-void get_checking_value(Settings &settings, double *checking_value) {
-  FILE *test_problem_file = std::fopen(settings.test_problem_filename, "r");
+// The problems of the test problems file as grid size, steps and expected temperature, read once by the master rank
+struct TestProblem {
+  int x;
+  int y;
+  int steps;
+  double value;
+};
+
+static bool test_problems_read = false;
+static bool test_problems_found = false;
+static std::vector<TestProblem> test_problems;
 
+// Reads the test problems file on first use, later decks of an ensemble looking their problems up in the same copy
+void read_test_problems(Settings &settings) {
+  if (test_problems_read) return;
+  test_problems_read = true;
+
+  FILE *test_problem_file = std::fopen(settings.test_problem_filename, "r");
   if (!test_problem_file) {
     print_and_log(settings, "\n WARNING: Could not open the test problem file: %s, expected value will be invalid.\n",
                   settings.test_problem_filename);
     return;
   }
+  test_problems_found = true;
 
   size_t len = 0;
   char *line = nullptr;
-
-  // Get the number of states present in the config file
   while (getline(&line, &len, test_problem_file) != EOF) {
-    int x;
-    int y;
-    int num_steps;
+    TestProblem problem{};
+    if (std::sscanf(line, "%d %d %d %lf", &problem.x, &problem.y, &problem.steps, &problem.value) == 4) {
+      test_problems.push_back(problem);
+    }
+  }
+  free(line);
+  std::fclose(test_problem_file);
+}
 
-    std::sscanf(line, "%d %d %d %lf", &x, &y, &num_steps, checking_value);
+// Fetches the checking value of the problem being run
+void get_checking_value(Settings &settings, double *checking_value) {
+  read_test_problems(settings);
+  if (!test_problems_found) return;
 
-    // Found the problem in the file
-    if (x == settings.grid_x_cells && y == settings.grid_y_cells && num_steps == settings.end_step) {
-      std::fclose(test_problem_file);
+  for (const TestProblem &problem : test_problems) {
+    if (problem.x == settings.grid_x_cells && problem.y == settings.grid_y_cells && problem.steps == settings.end_step) {
+      *checking_value = problem.value;
       return;
     }
   }
 
   *checking_value = 1.0;
   print_and_log(settings, "\n WARNING: Problem was not found in the test problems file, expected value will be invalid.\n");
-  std::fclose(test_problem_file);
 }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "settings.h"
+#include "shared.h"
+
+/*
+ *		FUSED HALO STRIPS
+ *		Lays out every exchanged field on every packed face as one index space, so that a single kernel
+ *		packs or unpacks them all. The buffers keep the layout of the per-field pack kernels.
+ */
+
+// One exchanged field on one face, rows of cols contiguous cells at the field's width, packed row after row
+struct HaloStrip {
+  double *field;
+  double *buffer;
+  int field_start;
+  int buffer_start;
+  int cols;
+  int first; // Index of the strip's first cell among the cells of all strips
+  int last;
+};
+
+struct HaloStrips {
+  HaloStrip strip[NUM_FACES * NUM_FIELDS];
+  int count;
+  int cells;
+};
+
+// The rows of the left and right faces, or the columns of the bottom and top faces, that a model's pack kernels cover
+struct HaloStripSpan {
+  int first;
+  int count;
+};
+
+// Fields not exchanged and faces without a buffer are null and skipped. Each face's buffer holds its fields one after another,
+// depth rows or columns of the full chunk apart, as the driver sizes messages
+inline HaloStrips halo_strips(int x, int y, int depth, int halo_depth, bool pack, double *const fields[NUM_FIELDS],
+                              double *const buffers[NUM_FACES], HaloStripSpan lr_rows, HaloStripSpan tb_cols) {
+  HaloStrips strips{};
+  for (int face = 0; face < NUM_FACES; ++face) {
+    if (!buffers[face]) continue;
+
+    bool lr = face == CHUNK_LEFT || face == CHUNK_RIGHT;
+    int field_start = 0;
+    switch (face) {
+      case CHUNK_LEFT: field_start = lr_rows.first * x + (pack ? halo_depth : halo_depth - depth); break;
+      case CHUNK_RIGHT: field_start = lr_rows.first * x + (pack ? x - halo_depth - depth : x - halo_depth); break;
+      case CHUNK_BOTTOM: field_start = (pack ? halo_depth : halo_depth - depth) * x + tb_cols.first; break;
+      case CHUNK_TOP: field_start = (pack ? y - halo_depth - depth : y - halo_depth) * x + tb_cols.first; break;
+    }
+    int cols = lr ? depth : tb_cols.count;
+    int cells = depth * (lr ? lr_rows.count : tb_cols.count);
+
+    int buffer_start = 0;
+    for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+      if (!fields[ff]) continue;
+      strips.strip[strips.count++] = {fields[ff], buffers[face], field_start, buffer_start, cols, strips.cells, strips.cells + cells};
+      strips.cells += cells;
+      buffer_start += depth * (lr ? y : x);
+    }
+  }
+  return strips;
+}
@@ -7,7 +7,10 @@ void halo_update_driver(Chunk *chunks, Settings &settings, int depth) {
   // Check that we actually have exchanges to perform
   if (!is_fields_to_exchange(settings)) return;
 
-  remote_halo_driver(chunks, settings, depth);
+  START_PROFILING(settings.kernel_profile);
+
+  // Local halos are reflected while a neighbourhood or one-sided exchange is in flight, they cover the faces without a neighbour
+  remote_halo_start(chunks, settings, depth);
 
   for (int cc = 0; cc < settings.num_chunks_per_rank; ++cc) {
     if (settings.kernel_language == Kernel_Language::C) {
@@ -16,4 +19,8 @@ void halo_update_driver(Chunk *chunks, Settings &settings, int depth) {
       // Fortran store energy kernel
     }
   }
+
+  remote_halo_finish(chunks, settings);
+
+  STOP_PROFILING(settings.kernel_profile, __func__);
 }
@@ -1,13 +1,140 @@
+#include <algorithm>
 #include <cfloat>
 #include <cstring>
+#include <vector>
 
 #include "application.h"
 #include "chunk.h"
 #include "comms.h"
 #include "drivers.h"
 #include "kernel_interface.h"
+#include "run_report.h"
 #include "settings.h"
 
+// Numbers the nodes in rank order and ranks within each node, returning the number of nodes
+static int index_nodes(const Settings &settings, const std::vector<int> &node_leaders, std::vector<int> &node_index,
+                       std::vector<int> &node_rank, std::vector<int> &node_sizes) {
+  std::vector<int> leaders;
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    auto found = std::find(leaders.begin(), leaders.end(), node_leaders[rr]);
+    if (found == leaders.end()) {
+      leaders.push_back(node_leaders[rr]);
+      node_sizes.push_back(0);
+      found = leaders.end() - 1;
+    }
+    node_index[rr] = static_cast<int>(found - leaders.begin());
+    node_rank[rr] = node_sizes[node_index[rr]]++;
+  }
+  return static_cast<int>(leaders.size());
+}
+
+// Lays out every node as the same block of chunks, the one of least perimeter that tiles the grid, so that most halo faces stay
+// within a node. Fails when the nodes hold different numbers of ranks or no block tiles the grid
+static bool map_ranks_to_nodes(const Settings &settings, const std::vector<int> &node_index, const std::vector<int> &node_rank,
+                               const std::vector<int> &node_sizes, std::vector<int> &cart_positions) {
+  int per_node = node_sizes[0];
+  if (std::count(node_sizes.begin(), node_sizes.end(), per_node) != static_cast<long>(node_sizes.size())) return false;
+
+  int block_x = 0;
+  int block_y = 0;
+  double best_perimeter = DBL_MAX;
+  for (int bx = 1; bx <= per_node; ++bx) {
+    int by = per_node / bx;
+    if (per_node % bx || settings.grid_x_chunks % bx || settings.grid_y_chunks % by) continue;
+
+    double perimeter = bx * static_cast<double>(settings.grid_x_cells) / settings.grid_x_chunks +
+                       by * static_cast<double>(settings.grid_y_cells) / settings.grid_y_chunks;
+    if (perimeter < best_perimeter) {
+      block_x = bx;
+      block_y = by;
+      best_perimeter = perimeter;
+    }
+  }
+  if (!block_x) return false;
+
+  // Blocks and the ranks within them are both laid out row-major, as the cartesian communicator orders positions
+  int blocks_y = settings.grid_y_chunks / block_y;
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    int xx = (node_index[rr] / blocks_y) * block_x + node_rank[rr] / block_y;
+    int yy = (node_index[rr] % blocks_y) * block_y + node_rank[rr] % block_y;
+    cart_positions[rr] = xx * settings.grid_y_chunks + yy;
+  }
+  return true;
+}
+
+// Bytes a single field exchanged at full halo depth sends between nodes, given the node at every row-major cartesian position
+static long internode_halo_bytes(const Settings &settings, const std::vector<int> &position_nodes) {
+  long bytes = 0;
+  for (int xx = 0; xx < settings.grid_x_chunks; ++xx) {
+    for (int yy = 0; yy < settings.grid_y_chunks; ++yy) {
+      int left, right, bottom, top;
+      calc_chunk_extents(settings, xx, yy, &left, &right, &bottom, &top);
+
+      // Each face is counted once, from its left or lower side, for the messages in both directions
+      int position = xx * settings.grid_y_chunks + yy;
+      if (xx + 1 < settings.grid_x_chunks && position_nodes[position] != position_nodes[position + settings.grid_y_chunks]) {
+        bytes += 2L * (top - bottom) * settings.halo_depth * sizeof(double);
+      }
+      if (yy + 1 < settings.grid_y_chunks && position_nodes[position] != position_nodes[position + 1]) {
+        bytes += 2L * (right - left) * settings.halo_depth * sizeof(double);
+      }
+    }
+  }
+  return bytes;
+}
+
+// Prints the node of every chunk, top row first, for grids narrow enough to read
+static void print_layout(Settings &settings, const char *name, const std::vector<int> &position_nodes) {
+  if (settings.grid_x_chunks > 32) return;
+  print_and_log_at(settings, LOG_DETAIL, " - %s layout:\n", name);
+  for (int yy = settings.grid_y_chunks - 1; yy >= 0; --yy) {
+    print_and_log_at(settings, LOG_DETAIL, "  ");
+    for (int xx = 0; xx < settings.grid_x_chunks; ++xx) {
+      print_and_log_at(settings, LOG_DETAIL, " %3d", position_nodes[xx * settings.grid_y_chunks + yy]);
+    }
+    print_and_log_at(settings, LOG_DETAIL, "\n");
+  }
+}
+
+// Chooses where each rank sits on the grid of chunks, returning false to keep the rank order
+static bool map_ranks(Settings &settings, std::vector<int> &cart_positions) {
+  std::vector<int> node_leaders(settings.num_ranks);
+  get_node_leaders(settings, node_leaders.data());
+
+  std::vector<int> node_index(settings.num_ranks), node_rank(settings.num_ranks), node_sizes;
+  int num_nodes = index_nodes(settings, node_leaders, node_index, node_rank, node_sizes);
+
+  std::vector<int> identity_nodes(node_index);
+  std::vector<int> mapped_nodes(settings.num_ranks);
+  long identity_bytes = internode_halo_bytes(settings, identity_nodes);
+  long mapped_bytes = identity_bytes;
+  bool mapped = settings.rank_mapping == RankMapping::NODE && num_nodes > 1 &&
+                map_ranks_to_nodes(settings, node_index, node_rank, node_sizes, cart_positions);
+  if (mapped) {
+    for (int rr = 0; rr < settings.num_ranks; ++rr) {
+      mapped_nodes[cart_positions[rr]] = node_index[rr];
+    }
+    mapped_bytes = internode_halo_bytes(settings, mapped_nodes);
+    // The rank order may already be as good, as when every node holds whole rows of chunks
+    mapped = mapped_bytes < identity_bytes;
+  }
+
+  print_and_log(settings, "Rank mapping:\n");
+  print_and_log(settings, " - Nodes:      %d\n", num_nodes);
+  print_and_log(settings, " - Layout:     %s\n", mapped ? "node-aware" : "rank order");
+  print_and_log(settings, " - Inter-node halo bytes per field exchange, rank order: %ld\n", identity_bytes);
+  if (mapped) {
+    print_and_log(settings, " - Inter-node halo bytes per field exchange, node-aware: %ld\n", mapped_bytes);
+  }
+  print_layout(settings, "Rank order", identity_nodes);
+  if (mapped) {
+    print_layout(settings, "Node-aware", mapped_nodes);
+  }
+
+  run_report_mapping(num_nodes, mapped ? mapped_nodes : identity_nodes, identity_bytes, mapped ? mapped_bytes : identity_bytes, mapped);
+  return mapped;
+}
+
 // Decomposes the field into multiple chunks
 void decompose_field(Settings &settings, Chunk *chunks) {
   // Calculates the num chunks field is to be decomposed into
@@ -50,42 +177,69 @@ void decompose_field(Settings &settings, Chunk *chunks) {
 
   settings.grid_x_chunks = x_chunks;
   settings.grid_y_chunks = y_chunks;
+  settings.chunk_x_edges.clear();
+  settings.chunk_y_edges.clear();
 
-  // Initialise a cartesian topology given the number of ranks calculated along X and Y axis
-  initialise_cart_topology(settings.grid_x_chunks, settings.grid_y_chunks, settings);
-
-  int dx = settings.grid_x_cells / x_chunks;
-  int dy = settings.grid_y_cells / y_chunks;
+  // Initialise a cartesian topology given the number of ranks calculated along X and Y axis, grouping the ranks of each node
+  std::vector<int> cart_positions(settings.num_ranks);
+  bool mapped = map_ranks(settings, cart_positions);
+  initialise_cart_topology(settings.grid_x_chunks, settings.grid_y_chunks, settings, mapped ? cart_positions.data() : nullptr);
 
-  int mod_x = settings.grid_x_cells % x_chunks;
-  int mod_y = settings.grid_y_cells % y_chunks;
-  int add_x_prev = 0;
-  int add_y_prev = 0;
+  // [0] because forked version of TeaLeaf does not allow more than 1 chunk per rank !
+  int left, right, bottom, top;
+  calc_chunk_extents(settings, settings.cart_coords[X_AXIS], settings.cart_coords[Y_AXIS], &left, &right, &bottom, &top);
+  initialise_chunk(&(chunks[0]), settings, right - left, top - bottom);
 
-  // Compute the full decomposition on all ranks
-  for (int yy = 0; yy < settings.grid_y_chunks; ++yy) {
-    int add_y = (yy < mod_y);
+  // Set up the mesh ranges
+  chunks[0].left = left;
+  chunks[0].right = right;
+  chunks[0].bottom = bottom;
+  chunks[0].top = top;
 
-    for (int xx = 0; xx < settings.grid_x_chunks; ++xx) {
-      int add_x = (xx < mod_x);
+  initialise_halo_exchange(chunks, settings);
+}
 
-      if (xx == settings.cart_coords[X_AXIS] && yy == settings.cart_coords[Y_AXIS]) {
-        // [0] because forked version of TeaLeaf does not allow more than 1 chunk per rank !
-        initialise_chunk(&(chunks[0]), settings, dx + add_x, dy + add_y);
+// Sets up the halo exchange modes of the deck for the allocated chunks, collective over the ranks of the cartesian communicator.
+// Chunks reused for another deck go through it again, as the deck may pick other modes
+void initialise_halo_exchange(Chunk *chunks, Settings &settings) {
+  // Datatypes are rebuilt on first use
+  finalise_halo_datatypes();
 
-        // Set up the mesh ranges
-        chunks[0].left = xx * dx + add_x_prev;
-        chunks[0].right = chunks[0].left + dx + add_x;
-        chunks[0].bottom = yy * dy + add_y_prev;
-        chunks[0].top = chunks[0].bottom + dy + add_y;
-      }
+  // Faces are counted from both of their sides
+  double shared_faces = initialise_shared_halos(settings, &(chunks[0]));
+  if (settings.shared_halos) {
+    int neighbour_ranks[NUM_NEIGHBOURS];
+    get_cart_neighbour_ranks(1, neighbour_ranks);
+    double faces = static_cast<double>(NUM_NEIGHBOURS - std::count(neighbour_ranks, neighbour_ranks + NUM_NEIGHBOURS, MPI_PROC_NULL));
+    sum_over_ranks(settings, &shared_faces);
+    sum_over_ranks(settings, &faces);
+    print_and_log(settings, "Shared-memory halos: %.0f of %.0f faces between ranks\n", shared_faces, faces);
+  }
+  initialise_rma_halos(settings, &(chunks[0]));
+}
 
-      // If chunks rounded up, maintain relative location
-      add_x_prev += add_x;
-    }
-    add_x_prev = 0;
-    add_y_prev += add_y;
+// Computes the mesh ranges of the chunk at the given cartesian coordinates, identically on all ranks
+void calc_chunk_extents(const Settings &settings, int xx, int yy, int *left, int *right, int *bottom, int *top) {
+  // Load balancing leaves the edges of every column and row
+  if (!settings.chunk_x_edges.empty()) {
+    *left = settings.chunk_x_edges[xx];
+    *right = settings.chunk_x_edges[xx + 1];
+    *bottom = settings.chunk_y_edges[yy];
+    *top = settings.chunk_y_edges[yy + 1];
+    return;
   }
+
+  int dx = settings.grid_x_cells / settings.grid_x_chunks;
+  int dy = settings.grid_y_cells / settings.grid_y_chunks;
+
+  int mod_x = settings.grid_x_cells % settings.grid_x_chunks;
+  int mod_y = settings.grid_y_cells % settings.grid_y_chunks;
+
+  // If chunks rounded up, maintain relative location
+  *left = xx * dx + std::min(xx, mod_x);
+  *right = *left + dx + (xx < mod_x);
+  *bottom = yy * dy + std::min(yy, mod_y);
+  *top = *bottom + dy + (yy < mod_y);
 }
 
 void initialise_model_info(Settings &settings) { run_model_info(settings); }
@@ -97,15 +251,25 @@ void initialise_application(Chunk **chunks, Settings &settings, State *states) {
 
   decompose_field(settings, *chunks);
   kernel_initialise_driver(*chunks, settings);
-  set_chunk_data_driver(*chunks, settings);
-  set_chunk_state_driver(*chunks, settings, states);
+  initialise_fields(*chunks, settings, states);
+}
+
+// Sets the mesh and initial state of already allocated chunks, which may be reused for any deck of the same grid
+void initialise_fields(Chunk *chunks, Settings &settings, State *states) {
+  for (int cc = 0; cc < settings.num_chunks_per_rank; ++cc) {
+    chunks[cc].dt_init = settings.dt_init;
+    chunks[cc].dt = settings.dt_init;
+  }
+
+  set_chunk_data_driver(chunks, settings);
+  set_chunk_state_driver(chunks, settings, states);
 
   // Prime the initial halo data
   reset_fields_to_exchange(settings);
   settings.fields_to_exchange[FIELD_DENSITY] = true; // start.f90:111
   settings.fields_to_exchange[FIELD_ENERGY0] = true; // start.f90:112
   settings.fields_to_exchange[FIELD_ENERGY1] = true; // start.f90:113
-  halo_update_driver(*chunks, settings, 2);
+  halo_update_driver(chunks, settings, 2);
 
-  store_energy_driver(*chunks, settings);
+  store_energy_driver(chunks, settings);
 }
@@ -5,6 +5,8 @@
 
 // Performs a full solve with the Jacobi solver kernels
 void jacobi_driver(Chunk *chunks, Settings &settings, double rx, double ry, double *error) {
+  START_PROFILING(settings.kernel_profile);
+
   jacobi_init_driver(chunks, settings, rx, ry);
 
   // Iterate till convergence
@@ -16,8 +18,11 @@ void jacobi_driver(Chunk *chunks, Settings &settings, double rx, double ry, doub
 
     if (fabs(*error) < settings.eps) break;
   }
+  settings.solve_iterations = tt;
+
+  print_and_log_at(settings, LOG_STEP, "Jacobi: \t\t%d iterations\n", tt);
 
-  print_and_log(settings, "Jacobi: \t\t%d iterations\n", tt);
+  STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
 // Invokes the CG initialisation kernels
@@ -14,6 +14,8 @@ void run_set_chunk_data(Chunk *chunk, Settings &settings);
 void run_set_chunk_state(Chunk *chunk, Settings &settings, State *states);
 void run_kernel_initialise(Chunk *chunk, Settings &settings, int comms_lr_len, int comms_tb_len);
 void run_kernel_finalise(Chunk *chunk, Settings &settings);
+void run_field_to_host(Chunk *chunk, Settings &settings, FieldBufferType field, double *host);
+void run_field_from_host(Chunk *chunk, Settings &settings, const double *host, FieldBufferType field);
 
 // Solver-wide kernels
 void run_local_halos(Chunk *chunk, Settings &settings, int depth);
@@ -23,6 +25,9 @@ void run_local_halos(Chunk *chunk, Settings &settings, int depth);
 
 void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, bool pack, FieldBufferType field,
                         FieldBufferType destination, int offset);
+// Packs or unpacks every field given on every face given a buffer, null entries skipped, each buffer laid out as by run_pack_or_unpack
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]);
 //
 void run_send_recv_halo(Chunk *chunk, Settings &settings,                                                       //
                         FieldBufferType src_send_buffer, FieldBufferType src_recv_buffer,                       //
@@ -0,0 +1,71 @@
+#include "kernel_traffic.h"
+#include "shared.h"
+#include <cstdio>
+
+// The stencil product tealeaf_SMVP loads kx, ky and its operand and costs 13 flops per cell
+static const KernelTraffic kernel_traffic_models[] = {
+    {"run_cg_init", 7, 9, 28},
+    {"run_cg_calc_w", 3, 1, 15},
+    {"run_cg_calc_ur", 4, 2, 6},
+    {"run_cg_calc_p", 2, 1, 2},
+    {"run_cheby_init", 6, 4, 16},
+    {"run_cheby_iterate", 7, 4, 18},
+    {"run_jacobi_init", 3, 4, 11},
+    {"run_jacobi_iterate", 5, 2, 15},
+    {"run_ppcg_init", 1, 1, 1},
+    {"run_ppcg_inner_iteration", 7, 3, 18},
+    {"run_copy_u", 1, 1, 0},
+    {"run_calculate_residual", 4, 1, 14},
+    {"run_calculate_2norm", 1, 0, 2},
+    {"run_finalise", 2, 1, 1},
+    {"run_store_energy", 1, 1, 0},
+    {"run_field_summary", 4, 0, 7},
+};
+
+const KernelTraffic *kernel_traffic_find(const std::string &name) {
+  for (const KernelTraffic &traffic : kernel_traffic_models) {
+    if (name == traffic.name) return &traffic;
+  }
+  return nullptr;
+}
+
+long kernel_traffic_cells(Chunk *chunks, Settings &settings) {
+  long cells = 0;
+  for (int cc = 0; cc < settings.num_chunks_per_rank; ++cc) {
+    cells += static_cast<long>(chunks[cc].x - 2 * settings.halo_depth) * (chunks[cc].y - 2 * settings.halo_depth);
+  }
+  return cells / settings.num_chunks_per_rank;
+}
+
+void kernel_traffic_print(Chunk *chunks, Settings &settings) {
+  long cells = kernel_traffic_cells(chunks, settings);
+  bool ipc = perf_counter_available(PERF_CYCLES) && perf_counter_available(PERF_INSTRUCTIONS);
+  bool llc = perf_counter_available(PERF_LLC_MISSES);
+
+  printf(" Kernel Throughput (%ld cells per call, modelled traffic):\n\n", cells);
+  printf(" %-28s%8s%14s%10s%10s%10s", "Kernel Name", "Calls", "Runtime (s)", "GB/s", "GFLOP/s", "Flop/B");
+  if (ipc) printf("%8s", "IPC");
+  if (llc) printf("%12s%12s", "LLC (GB/s)", "LLC Flop/B");
+  printf("\n");
+
+  for (const ProfileEntry &entry : profiler_flat_entries(settings.kernel_profile)) {
+    const KernelTraffic *traffic = kernel_traffic_find(entry.name);
+    if (!traffic || !entry.calls || entry.time <= 0.0) continue;
+
+    double bytes = kernel_traffic_bytes(*traffic) * cells * entry.calls;
+    double flops = static_cast<double>(traffic->flops) * cells * entry.calls;
+    printf(" %-28s%8ld%14.03F%10.02F%10.02F%10.03F", entry.name.c_str(), entry.calls, entry.time, bytes / entry.time * 1.0E-9,
+           flops / entry.time * 1.0E-9, flops / bytes);
+
+    // Every last-level cache miss is a line fetched from memory
+    const double *counters = entry.counters.values;
+    if (ipc) printf("%8.02F", counters[PERF_CYCLES] > 0.0 ? counters[PERF_INSTRUCTIONS] / counters[PERF_CYCLES] : 0.0);
+    if (llc) {
+      double llc_bytes = counters[PERF_LLC_MISSES] * PERF_CACHE_LINE_BYTES;
+      printf("%12.02F%12.03F", llc_bytes / entry.time * 1.0E-9, llc_bytes > 0.0 ? flops / llc_bytes : 0.0);
+    }
+    printf("\n");
+  }
+
+  printf("\n -------------------------------------------------------------\n\n");
+}
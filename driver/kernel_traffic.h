@@ -0,0 +1,37 @@
+#pragma once
+
+#include "chunk.h"
+#include <string>
+
+/*
+ *		KERNEL TRAFFIC MODEL
+ *		Memory traffic and arithmetic of each run_* kernel per interior cell, counting every field
+ *		once as if streamed from memory without write-allocate. Divided by the measured time this
+ *		places each kernel on a roofline.
+ */
+
+struct KernelTraffic {
+  const char *name;
+  int reads;  // Doubles loaded per cell
+  int writes; // Doubles stored per cell
+  int flops;  // Floating point operations per cell
+};
+
+// The model of a kernel, nullptr for kernels without one
+const KernelTraffic *kernel_traffic_find(const std::string &name);
+
+inline double kernel_traffic_bytes(const KernelTraffic &traffic) { return (traffic.reads + traffic.writes) * sizeof(double); }
+
+// Interior cells processed by one call of a kernel on a chunk of this rank
+long kernel_traffic_cells(Chunk *chunks, Settings &settings);
+
+// Prints the modelled throughput of this rank's kernels next to their timing, and the measured counters if enabled
+void kernel_traffic_print(Chunk *chunks, Settings &settings);
+
+#ifdef ENABLE_PROFILING
+  #define PRINT_KERNEL_THROUGHPUT(chunks, settings) kernel_traffic_print(chunks, settings)
+#else
+  #define PRINT_KERNEL_THROUGHPUT(chunks, settings) \
+    do {                                            \
+    } while (false)
+#endif
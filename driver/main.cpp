@@ -1,10 +1,18 @@
+#include <algorithm>
 #include <optional>
 
 #include "application.h"
+#include "bench_sweep.h"
 #include "chunk.h"
 #include "comms.h"
 #include "drivers.h"
+#include "ensemble.h"
+#include "kernel_traffic.h"
+#include "profile_report.h"
+#include "run_report.h"
 #include "shared.h"
+#include "trace.h"
+#include "vtk_writer.h"
 
 void settings_overload(Settings &settings, int argc, char **argv) {
   for (int aa = 1; aa < argc; ++aa) {
@@ -39,6 +47,44 @@ void settings_overload(Settings &settings, int argc, char **argv) {
     } else if (tealeaf_strmatch(argv[aa], "--out") || tealeaf_strmatch(argv[aa], "-o")) {
       if (aa + 1 == argc) break;
       settings.tea_out_filename = argv[aa + 1];
+    } else if (tealeaf_strmatch(argv[aa], "--report")) {
+      if (aa + 1 == argc) break;
+      settings.tea_report_filename = argv[aa + 1];
+    } else if (tealeaf_strmatch(argv[aa], "--verbosity")) {
+      if (aa + 1 == argc) break;
+      settings.verbosity = std::max(LOG_QUIET, std::min(LOG_DETAIL, std::atoi(argv[aa + 1])));
+    } else if (tealeaf_strmatch(argv[aa], "--quiet") || tealeaf_strmatch(argv[aa], "-q")) {
+      settings.verbosity = LOG_QUIET;
+    } else if (tealeaf_strmatch(argv[aa], "--unbuffered-log")) {
+      settings.log_buffered = false;
+    } else if (tealeaf_strmatch(argv[aa], "--trace")) {
+      if (aa + 1 == argc) break;
+      settings.trace_filename = argv[aa + 1];
+    } else if (tealeaf_strmatch(argv[aa], "--trace-capacity")) {
+      if (aa + 1 == argc) break;
+      settings.trace_capacity = std::max(1, std::atoi(argv[aa + 1]));
+    } else if (tealeaf_strmatch(argv[aa], "--bench-sweep")) {
+      if (aa + 1 == argc) break;
+      settings.bench_sweep_sizes = argv[aa + 1];
+    } else if (tealeaf_strmatch(argv[aa], "--bench-scaling")) {
+      if (aa + 1 == argc) break;
+      if (tealeaf_strmatch(argv[aa + 1], "strong")) settings.bench_scaling = BenchScaling::STRONG;
+      if (tealeaf_strmatch(argv[aa + 1], "weak")) settings.bench_scaling = BenchScaling::WEAK;
+    } else if (tealeaf_strmatch(argv[aa], "--bench-iterations")) {
+      if (aa + 1 == argc) break;
+      settings.bench_iterations = std::max(1, std::atoi(argv[aa + 1]));
+    } else if (tealeaf_strmatch(argv[aa], "--bench-output")) {
+      if (aa + 1 == argc) break;
+      settings.bench_output_filename = argv[aa + 1];
+    } else if (tealeaf_strmatch(argv[aa], "--ensemble")) {
+      if (aa + 1 == argc) break;
+      settings.ensemble_filename = argv[aa + 1];
+    } else if (tealeaf_strmatch(argv[aa], "--ensemble-groups")) {
+      if (aa + 1 == argc) break;
+      settings.ensemble_groups = std::max(1, std::atoi(argv[aa + 1]));
+    } else if (tealeaf_strmatch(argv[aa], "--ensemble-output")) {
+      if (aa + 1 == argc) break;
+      settings.ensemble_output_filename = argv[aa + 1];
     } else if (tealeaf_strmatch(argv[aa], "-help") || tealeaf_strmatch(argv[aa], "--help") || tealeaf_strmatch(argv[aa], "-h")) {
       print_and_log(settings, "tealeaf <options>\n");
       print_and_log(settings, "options:\n");
@@ -50,12 +96,43 @@ void settings_overload(Settings &settings, int argc, char **argv) {
       print_and_log(settings, "\t\tInput deck file path'\n");
       print_and_log(settings, "\t-o, --out:\n");
       print_and_log(settings, "\t\tOutput file path'\n");
+      print_and_log(settings, "\t--report:\n");
+      print_and_log(settings, "\t\tJSON run report path, written once at exit. Defaults to %s.'\n", DEF_TEA_REPORT_FILENAME);
       print_and_log(settings, "\t--staging-buffer:\n");
       print_and_log(settings, "\t\tIf true, use a host staging buffer for device-host MPI halo exchange.'\n");
       print_and_log(settings, "\t\tIf false, use device pointers directly for MPI halo exchange.'\n");
       print_and_log(settings, "\t\tDefaults to auto which elides the buffer if a device-aware (i.e CUDA-aware) is used.'\n");
       print_and_log(settings, "\t\tThis option is no-op for CPU-only models.'\n");
       print_and_log(settings, "\t\tSetting this to false on an MPI that is not device-aware may cause a segfault.'\n");
+      print_and_log(settings, "\t--verbosity:\n");
+      print_and_log(settings, "\t\t0 prints no per-timestep output, 1 the iterations, wallclock and error of each timestep,'\n");
+      print_and_log(settings, "\t\t2 also eigenvalue estimates and time per cell. Defaults to %d.'\n", DEF_VERBOSITY);
+      print_and_log(settings, "\t-q, --quiet:\n");
+      print_and_log(settings, "\t\tSame as --verbosity 0.'\n");
+      print_and_log(settings, "\t--unbuffered-log:\n");
+      print_and_log(settings, "\t\tWrites every message to stdout and the log immediately instead of at summary points.'\n");
+      print_and_log(settings, "\t--trace:\n");
+      print_and_log(settings, "\t\tWrites a Chrome/Perfetto JSON timeline of all ranks to the given file at exit.'\n");
+      print_and_log(settings, "\t\tRequires a build with ENABLE_PROFILING.'\n");
+      print_and_log(settings, "\t--trace-capacity:\n");
+      print_and_log(settings, "\t\tEvents kept per rank, the oldest are dropped beyond it. Defaults to %d.'\n", DEF_TRACE_CAPACITY);
+      print_and_log(settings, "\t--bench-sweep:\n");
+      print_and_log(settings, "\t\tInstead of solving the deck once, reruns it for each of the comma separated grid sizes.'\n");
+      print_and_log(settings, "\t\tEvery solve runs a fixed number of iterations and the timings are written as JSON.'\n");
+      print_and_log(settings, "\t--bench-scaling:\n");
+      print_and_log(settings, "\t\tCan be 'strong' for size x size cells in total, or 'weak' for size x size cells per rank.'\n");
+      print_and_log(settings, "\t--bench-iterations:\n");
+      print_and_log(settings, "\t\tSolver iterations per step in a sweep. Defaults to %d.'\n", DEF_BENCH_ITERATIONS);
+      print_and_log(settings, "\t--bench-output:\n");
+      print_and_log(settings, "\t\tJSON file the sweep results are written to. Defaults to %s.'\n", DEF_BENCH_OUTPUT_FILENAME);
+      print_and_log(settings, "\t--ensemble:\n");
+      print_and_log(settings, "\t\tInstead of solving the deck, runs every case of the given file, one deck per line followed by'\n");
+      print_and_log(settings, "\t\t'key=value' settings overriding it, a comma separated list of values giving one case each.'\n");
+      print_and_log(settings, "\t--ensemble-groups:\n");
+      print_and_log(settings, "\t\tSplits the ranks into this many groups running cases concurrently. Defaults to %d.'\n",
+                    DEF_ENSEMBLE_GROUPS);
+      print_and_log(settings, "\t--ensemble-output:\n");
+      print_and_log(settings, "\t\tJSON file the outcome of all cases is written to. Defaults to %s.'\n", DEF_ENSEMBLE_OUTPUT_FILENAME);
       finalise_comms();
       std::exit(EXIT_SUCCESS);
     }
@@ -106,8 +183,6 @@ int main(int argc, char **argv) {
 #endif
 
   initialise_model_info(settings);
-  State *states{};
-  read_config(settings, &states);
 
   switch (settings.staging_buffer_preference) {
     case StagingBuffer::ENABLE: settings.staging_buffer = true; break;
@@ -117,6 +192,20 @@ int main(int argc, char **argv) {
       break;
   }
 
+  // An ensemble reads its own decks in place of the one given
+  if (settings.ensemble_filename) {
+    bool valid = ensemble(settings);
+    profiler_finalise(&settings.kernel_profile);
+    profiler_finalise(&settings.application_profile);
+    profiler_finalise(&settings.wallclock_profile);
+    finalise_log(settings);
+    finalise_comms();
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  State *states{};
+  read_config(settings, &states);
+
   std::string execution_kind;
   switch (settings.model_kind) {
     case ModelKind::Host: execution_kind = "Host"; break;
@@ -128,6 +217,7 @@ int main(int argc, char **argv) {
   print_and_log(settings, " - Ver.:     %s\n", TEALEAF_VERSION);
   print_and_log(settings, " - Deck:     %s\n", settings.tea_in_filename);
   print_and_log(settings, " - Out:      %s\n", settings.tea_out_filename);
+  print_and_log(settings, " - Report:   %s\n", settings.tea_report_filename);
   print_and_log(settings, " - Problem:  %s\n", settings.check_result ? settings.test_problem_filename : "-");
   print_and_log(settings, " - Solver:   %s\n", settings.solver_name);
   print_and_log(settings, " - Profiler: %s\n", profiling ? "true" : "false");
@@ -135,6 +225,17 @@ int main(int argc, char **argv) {
   print_and_log(settings, " - Name:      %s\n", settings.model_name.c_str());
   print_and_log(settings, " - Execution: %s\n", execution_kind.c_str());
 
+  // A benchmark sweep replaces the solve of the deck
+  if (settings.bench_sweep_sizes) {
+    bench_sweep(settings, states);
+    profiler_finalise(&settings.kernel_profile);
+    profiler_finalise(&settings.application_profile);
+    profiler_finalise(&settings.wallclock_profile);
+    finalise_log(settings);
+    finalise_comms();
+    return EXIT_SUCCESS;
+  }
+
   // Perform initialisation steps
   Chunk *chunks{};
   initialise_application(&chunks, settings, states);
@@ -164,6 +265,9 @@ int main(int argc, char **argv) {
   print_and_log(settings, "# ---- \n");
   print_and_log(settings, "Output: |+1\n");
 
+  perf_counters_initialise(settings);
+  trace_initialise(settings);
+
   // Perform the solve using default or overloaded diffuse
 #ifndef DIFFUSE_OVERLOAD
   bool valid = diffuse(chunks, settings);
@@ -171,13 +275,31 @@ int main(int argc, char **argv) {
   bool valid = diffuse_overload(chunks, settings);
 #endif
 
+  // Wait for any visualisation dumps still being written
+  vtk_writer_finalise();
+
+  // The profiling reports print directly, so the log must be out first
+  flush_log(settings);
+
   // Print the kernel-level profiling results
   if (settings.rank == MASTER) {
     PRINT_PROFILING_RESULTS(settings.kernel_profile);
+    PRINT_KERNEL_THROUGHPUT(chunks, settings);
+  }
+  perf_counters_finalise();
+
+  // Compare the kernel-level profiles of all ranks
+  PRINT_RANK_PROFILING_RESULTS(settings);
+
+  trace_finalise(settings);
+
+  if (settings.rank == MASTER) {
+    run_report_write(settings, valid);
   }
 
   print_and_log(settings, "Result:\n");
-  print_and_log(settings, " - Problem: %dx%d@%d\n", settings.grid_x_cells, settings.grid_y_cells, settings.end_step);
+  print_and_log(settings, " - Problem: %dx%d@%d\n", settings.grid_x_cells, settings.grid_y_cells, settings.sim_steps);
+  print_and_log(settings, " - Time:    %.6e\n", settings.sim_time);
   print_and_log(settings, " - Outcome: %s\n", (!valid ? "FAILED" : "PASSED"));
 
   // Finalise the kernel
@@ -194,6 +316,7 @@ int main(int argc, char **argv) {
   profiler_finalise(&settings.wallclock_profile);
 
   // Finalise the application
+  finalise_log(settings);
   finalise_comms();
 
   return valid ? EXIT_SUCCESS : EXIT_FAILURE;
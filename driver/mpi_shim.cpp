@@ -1,5 +1,6 @@
 #include "mpi_shim.h"
 #include <cstdio>
+#include <cstring>
 
 #ifdef NO_MPI
 
@@ -22,16 +23,136 @@ int MPI_Abort(MPI_Comm, int errorcode) {
 
 int MPI_Finalize() { return MPI_SUCCESS; }
 
+int MPI_Comm_split(MPI_Comm comm, int, int, MPI_Comm *newcomm) {
+  // XXX correct for 1 rank only
+  *newcomm = comm;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int, int, MPI_Info, MPI_Comm *newcomm) {
+  // XXX correct for 1 rank only
+  *newcomm = comm;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_free(MPI_Comm *comm) {
+  *comm = MPI_COMM_WORLD;
+  return MPI_SUCCESS;
+}
+
+// The window handle is the segment of the only rank
+int MPI_Comm_group(MPI_Comm, MPI_Group *group) {
+  *group = MPI_GROUP_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Group_incl(MPI_Group, int, const int[], MPI_Group *newgroup) {
+  *newgroup = MPI_GROUP_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Group_translate_ranks(MPI_Group, int n, const int ranks1[], MPI_Group, int ranks2[]) {
+  std::memcpy(ranks2, ranks1, sizeof(int) * n);
+  return MPI_SUCCESS;
+}
+
+int MPI_Group_free(MPI_Group *group) {
+  *group = MPI_GROUP_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info, MPI_Comm, void *baseptr, MPI_Win *win) {
+  *win = std::calloc(size > 0 ? size : 1, disp_unit);
+  *static_cast<void **>(baseptr) = *win;
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info, MPI_Comm, void *baseptr, MPI_Win *win) {
+  *win = std::calloc(size > 0 ? size : 1, disp_unit);
+  *static_cast<void **>(baseptr) = *win;
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_shared_query(MPI_Win win, int, MPI_Aint *size, int *disp_unit, void *baseptr) {
+  // XXX correct for 1 rank only
+  *size = 0;
+  *disp_unit = 1;
+  *static_cast<void **>(baseptr) = win;
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_free(MPI_Win *win) {
+  std::free(*win);
+  *win = nullptr;
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_post(MPI_Group, int, MPI_Win) {
+  // XXX no-op, a single rank has no neighbours to expose its window to
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_start(MPI_Group, int, MPI_Win) { return MPI_SUCCESS; }
+
+int MPI_Put(const void *, int, MPI_Datatype, int, MPI_Aint, int, MPI_Datatype, MPI_Win) {
+  // XXX no-op, a single rank has no neighbours to put to
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_complete(MPI_Win) { return MPI_SUCCESS; }
+
+int MPI_Win_wait(MPI_Win) { return MPI_SUCCESS; }
+
 int MPI_Barrier(MPI_Comm) {
   // XXX no-op, correct for 1 rank only
   return MPI_SUCCESS;
 }
 
+int MPI_Bcast(void *, int, MPI_Datatype, int, MPI_Comm) {
+  // XXX no-op, correct for 1 rank only
+  return MPI_SUCCESS;
+}
+
 int MPI_Allgather(const void *, int, MPI_Datatype, void *, int, MPI_Datatype, MPI_Comm) {
   // XXX no-op, correct for 1 rank only
   return MPI_SUCCESS;
 }
 
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int, MPI_Datatype, int, MPI_Comm) {
+  // XXX correct for 1 rank only
+  if (sendcount) std::memcpy(recvbuf, sendbuf, sendcount * sendtype);
+  return MPI_SUCCESS;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int *, const int *displs,
+                MPI_Datatype recvtype, int, MPI_Comm) {
+  // XXX correct for 1 rank only
+  if (sendcount) std::memcpy(static_cast<char *>(recvbuf) + displs[0] * recvtype, sendbuf, sendcount * sendtype);
+  return MPI_SUCCESS;
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispls, MPI_Datatype sendtype, void *recvbuf, const int *,
+                  const int *rdispls, MPI_Datatype recvtype, MPI_Comm) {
+  // XXX correct for 1 rank only
+  if (sendcounts[0]) {
+    std::memcpy(static_cast<char *>(recvbuf) + rdispls[0] * recvtype, static_cast<const char *>(sendbuf) + sdispls[0] * sendtype,
+                sendcounts[0] * sendtype);
+  }
+  return MPI_SUCCESS;
+}
+
+int MPI_Ineighbor_alltoallv(const void *, const int[], const int[], MPI_Datatype, void *, const int[], const int[], MPI_Datatype, MPI_Comm,
+                            MPI_Request *request) {
+  // XXX no-op, a single rank has no neighbours
+  *request = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *) {
+  *request = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
 int MPI_Reduce(const void *, void *, int, MPI_Datatype, MPI_Op, int, MPI_Comm) {
   // XXX no-op, correct for 1 rank only
   return MPI_SUCCESS;
@@ -42,6 +163,30 @@ int MPI_Allreduce(const void *, void *, int, MPI_Datatype, MPI_Op, MPI_Comm) {
   return MPI_SUCCESS;
 }
 
+int MPI_Get_address(const void *location, MPI_Aint *address) {
+  *address = reinterpret_cast<MPI_Aint>(location);
+  return MPI_SUCCESS;
+}
+
+int MPI_Type_vector(int, int, int, MPI_Datatype, MPI_Datatype *newtype) {
+  // XXX no-op, a single rank has no halo messages to describe
+  *newtype = MPI_DATATYPE_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Type_create_struct(int, const int[], const MPI_Aint[], const MPI_Datatype[], MPI_Datatype *newtype) {
+  // XXX no-op, a single rank has no halo messages to describe
+  *newtype = MPI_DATATYPE_NULL;
+  return MPI_SUCCESS;
+}
+
+int MPI_Type_commit(MPI_Datatype *) { return MPI_SUCCESS; }
+
+int MPI_Type_free(MPI_Datatype *datatype) {
+  *datatype = MPI_DATATYPE_NULL;
+  return MPI_SUCCESS;
+}
+
 int MPI_Sendrecv(const void *, int, MPI_Datatype, int, int, void *, int, MPI_Datatype, int, int, MPI_Comm, MPI_Status *) {
   fprintf(stderr, "MPI disabled, stub: %s\n", __func__);
   std::abort();
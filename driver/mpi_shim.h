@@ -9,21 +9,34 @@
   #define MPI_ERR_TYPE (3)
   #define MPI_ERR_BUFFER (4)
 
-  #define MPI_INT (0)
-  #define MPI_LONG (0)
-  #define MPI_DOUBLE (0)
+  // Datatypes are their size in bytes, so that rooted collectives can copy on 1 rank
+  #define MPI_CHAR ((int)sizeof(char))
+  #define MPI_INT ((int)sizeof(int))
+  #define MPI_LONG ((int)sizeof(long))
+  #define MPI_DOUBLE ((int)sizeof(double))
   #define MPI_SUM (0)
   #define MPI_MIN (0)
   #define MPI_MAX (0)
   #define MPI_STATUS_IGNORE (0)
   #define MPI_STATUSES_IGNORE (0)
 
+  #define MPI_DATATYPE_NULL (0)
+  #define MPI_BOTTOM (nullptr)
   #define MPI_COMM_WORLD (0)
+  #define MPI_INFO_NULL (0)
+  #define MPI_COMM_TYPE_SHARED (1)
+  #define MPI_REQUEST_NULL (0)
+  #define MPI_GROUP_NULL (0)
 
 using MPI_Comm = int;
 using MPI_Datatype = int;
 using MPI_Op = int;
+using MPI_Info = int;
+using MPI_Aint = long;
+using MPI_Win = void *;
 using MPI_Status = int;
+using MPI_Request = int;
+using MPI_Group = int;
 
 int MPI_Init(int *argc, char ***argv);
 int MPI_Comm_rank(MPI_Comm comm, int *rank);
@@ -31,11 +44,47 @@ int MPI_Comm_size(MPI_Comm comm, int *size);
 int MPI_Abort(MPI_Comm comm, int errorcode);
 int MPI_Barrier(MPI_Comm comm);
 int MPI_Finalize();
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm);
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm);
+int MPI_Comm_free(MPI_Comm *comm);
+
+int MPI_Comm_group(MPI_Comm comm, MPI_Group *group);
+int MPI_Group_incl(MPI_Group group, int n, const int ranks[], MPI_Group *newgroup);
+int MPI_Group_translate_ranks(MPI_Group group1, int n, const int ranks1[], MPI_Group group2, int ranks2[]);
+int MPI_Group_free(MPI_Group *group);
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr, MPI_Win *win);
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr, MPI_Win *win);
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr);
+int MPI_Win_free(MPI_Win *win);
+int MPI_Win_post(MPI_Group group, int assert, MPI_Win win);
+int MPI_Win_start(MPI_Group group, int assert, MPI_Win win);
+int MPI_Put(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank, MPI_Aint target_disp,
+            int target_count, MPI_Datatype target_datatype, MPI_Win win);
+int MPI_Win_complete(MPI_Win win);
+int MPI_Win_wait(MPI_Win win);
+
+int MPI_Get_address(const void *location, MPI_Aint *address);
+int MPI_Type_vector(int count, int blocklength, int stride, MPI_Datatype oldtype, MPI_Datatype *newtype);
+int MPI_Type_create_struct(int count, const int blocklengths[], const MPI_Aint displacements[], const MPI_Datatype types[],
+                           MPI_Datatype *newtype);
+int MPI_Type_commit(MPI_Datatype *datatype);
+int MPI_Type_free(MPI_Datatype *datatype);
 
 int MPI_Sendrecv(const void *, int, MPI_Datatype, int, int, void *, int, MPI_Datatype, int, int, MPI_Comm, MPI_Status *);
 int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm);
 int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
+               MPI_Comm comm);
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int *recvcounts, const int *displs,
+                MPI_Datatype recvtype, int root, MPI_Comm comm);
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm);
 int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype,
                   MPI_Comm comm);
+int MPI_Alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispls, MPI_Datatype sendtype, void *recvbuf,
+                  const int *recvcounts, const int *rdispls, MPI_Datatype recvtype, MPI_Comm comm);
+int MPI_Ineighbor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype, void *recvbuf,
+                            const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request);
+int MPI_Wait(MPI_Request *request, MPI_Status *status);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,666 @@
+#include "mpi_threads.h"
+
+#ifdef MPI_THREADS
+
+  #include <algorithm>
+  #include <condition_variable>
+  #include <cstdio>
+  #include <cstdlib>
+  #include <cstring>
+  #include <deque>
+  #include <memory>
+  #include <mutex>
+  #include <thread>
+  #include <vector>
+
+  // The only communicator besides MPI_COMM_WORLD, same ranks without reordering
+  #define MPI_THREADS_CART_COMM (1)
+
+  // Handles of derived datatypes start here, above the predefined ones
+  #define MPI_THREADS_DERIVED_TYPE (16)
+
+  // Neighbourhood collectives travel as messages tagged below every user tag, one tag per slot of the sender
+  #define MPI_THREADS_NEIGHBOR_TAG (-16)
+
+// A receive, or a collective made of the receives in parts
+struct MPIThreadsRequest {
+  void *buffer;
+  int count;
+  MPI_Datatype datatype;
+  int source;
+  int tag;
+  MPI_Comm comm;
+  bool recv;
+  std::vector<MPIThreadsRequest> parts;
+};
+
+namespace {
+
+struct Message {
+  int source;
+  int tag;
+  MPI_Comm comm;
+  std::vector<char> data;
+};
+
+// Sends are eager, a message waits in the receiver's mailbox until a matching receive takes it
+struct Mailbox {
+  std::mutex mutex;
+  std::condition_variable arrived;
+  std::deque<Message> messages;
+};
+
+} // namespace
+
+static int world_size = 1;
+static thread_local int world_rank = 0;
+static std::vector<std::unique_ptr<Mailbox>> mailboxes;
+
+static int cart_dims[2] = {1, 1};
+
+// Collectives publish each rank's buffers, synchronise, read what they need and synchronise again before returning
+static std::mutex collective_mutex;
+static std::condition_variable collective_done;
+static int barrier_waiting = 0;
+static long barrier_generation = 0;
+static std::vector<const void *> collective_buffers;
+static std::vector<const int *> collective_displs;
+
+static int datatype_size(MPI_Datatype datatype) {
+  switch (datatype) {
+    case MPI_CHAR: return sizeof(char);
+    case MPI_INT: return sizeof(int);
+    case MPI_LONG: return sizeof(long);
+    case MPI_DOUBLE: return sizeof(double);
+    default: std::fprintf(stderr, "MPI threads: unsupported datatype %d\n", datatype); std::exit(EXIT_FAILURE);
+  }
+}
+
+// Derived datatypes are flattened into the byte ranges they cover relative to the buffer, as (offset, length) pairs. They are
+// never reused once freed, so a reference stays valid without holding the lock
+struct DerivedType {
+  std::vector<std::pair<long, long>> blocks;
+  long extent;
+};
+
+static std::mutex types_mutex;
+static std::deque<DerivedType> derived_types;
+
+static bool is_derived(MPI_Datatype datatype) { return datatype >= MPI_THREADS_DERIVED_TYPE; }
+
+static const DerivedType &derived_type(MPI_Datatype datatype) {
+  std::lock_guard<std::mutex> lock(types_mutex);
+  return derived_types[datatype - MPI_THREADS_DERIVED_TYPE];
+}
+
+static MPI_Datatype add_derived_type(DerivedType type) {
+  std::lock_guard<std::mutex> lock(types_mutex);
+  derived_types.push_back(std::move(type));
+  return MPI_THREADS_DERIVED_TYPE + static_cast<int>(derived_types.size()) - 1;
+}
+
+static long datatype_extent(MPI_Datatype datatype) {
+  return is_derived(datatype) ? derived_type(datatype).extent : datatype_size(datatype);
+}
+
+// Appends the byte ranges of count consecutive elements of the datatype starting at offset
+static void flatten(MPI_Datatype datatype, long offset, int count, std::vector<std::pair<long, long>> &blocks) {
+  if (!is_derived(datatype)) {
+    blocks.emplace_back(offset, static_cast<long>(count) * datatype_size(datatype));
+    return;
+  }
+  const DerivedType &type = derived_type(datatype);
+  for (int ii = 0; ii < count; ++ii) {
+    for (const std::pair<long, long> &block : type.blocks) {
+      blocks.emplace_back(offset + ii * type.extent + block.first, block.second);
+    }
+  }
+}
+
+// Gathers the elements a message carries into contiguous bytes
+static std::vector<char> pack(const void *buf, int count, MPI_Datatype datatype) {
+  std::vector<std::pair<long, long>> blocks;
+  flatten(datatype, 0, count, blocks);
+  std::vector<char> data;
+  for (const std::pair<long, long> &block : blocks) {
+    const char *start = static_cast<const char *>(buf) + block.first;
+    data.insert(data.end(), start, start + block.second);
+  }
+  return data;
+}
+
+// Scatters received bytes over the elements, returning the number of bytes the elements hold
+static long unpack(void *buf, int count, MPI_Datatype datatype, const std::vector<char> &data) {
+  std::vector<std::pair<long, long>> blocks;
+  flatten(datatype, 0, count, blocks);
+  long position = 0;
+  for (const std::pair<long, long> &block : blocks) {
+    long bytes = std::min<long>(block.second, static_cast<long>(data.size()) - position);
+    if (bytes > 0) std::memcpy(static_cast<char *>(buf) + block.first, data.data() + position, bytes);
+    position += block.second;
+  }
+  return position;
+}
+
+static void threads_barrier() {
+  std::unique_lock<std::mutex> lock(collective_mutex);
+  long generation = barrier_generation;
+  if (++barrier_waiting == world_size) {
+    barrier_waiting = 0;
+    ++barrier_generation;
+    collective_done.notify_all();
+  } else {
+    collective_done.wait(lock, [&] { return barrier_generation != generation; });
+  }
+}
+
+template <typename T> static void reduce_into(T *result, const T *operand, int count, MPI_Op op) {
+  for (int ii = 0; ii < count; ++ii) {
+    switch (op) {
+      case MPI_SUM: result[ii] += operand[ii]; break;
+      case MPI_MIN: result[ii] = std::min(result[ii], operand[ii]); break;
+      case MPI_MAX: result[ii] = std::max(result[ii], operand[ii]); break;
+    }
+  }
+}
+
+// Reduces the published buffers in rank order, so that every rank computes the same result
+static void reduce_published(void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op) {
+  std::memcpy(recvbuf, collective_buffers[0], count * datatype_size(datatype));
+  for (int rr = 1; rr < world_size; ++rr) {
+    switch (datatype) {
+      case MPI_CHAR: reduce_into(static_cast<char *>(recvbuf), static_cast<const char *>(collective_buffers[rr]), count, op); break;
+      case MPI_INT: reduce_into(static_cast<int *>(recvbuf), static_cast<const int *>(collective_buffers[rr]), count, op); break;
+      case MPI_LONG: reduce_into(static_cast<long *>(recvbuf), static_cast<const long *>(collective_buffers[rr]), count, op); break;
+      case MPI_DOUBLE: reduce_into(static_cast<double *>(recvbuf), static_cast<const double *>(collective_buffers[rr]), count, op); break;
+    }
+  }
+}
+
+void mpi_threads_launch(int num_ranks, const std::function<void()> &body) {
+  world_size = num_ranks;
+  mailboxes.clear();
+  for (int rr = 0; rr < num_ranks; ++rr) {
+    mailboxes.push_back(std::make_unique<Mailbox>());
+  }
+  collective_buffers.assign(num_ranks, nullptr);
+  collective_displs.assign(num_ranks, nullptr);
+
+  std::vector<std::thread> ranks;
+  for (int rr = 0; rr < num_ranks; ++rr) {
+    ranks.emplace_back([rr, &body] {
+      world_rank = rr;
+      body();
+    });
+  }
+  for (std::thread &rank : ranks) {
+    rank.join();
+  }
+}
+
+int MPI_Init(int *, char ***) {
+  if (mailboxes.empty()) mailboxes.push_back(std::make_unique<Mailbox>());
+  if (collective_buffers.empty()) collective_buffers.assign(1, nullptr);
+  if (collective_displs.empty()) collective_displs.assign(1, nullptr);
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_rank(MPI_Comm, int *rank) {
+  *rank = world_rank;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_size(MPI_Comm, int *size) {
+  *size = world_size;
+  return MPI_SUCCESS;
+}
+
+int MPI_Abort(MPI_Comm, int errorcode) {
+  std::exit(errorcode);
+  return MPI_SUCCESS;
+}
+
+int MPI_Finalize() { return MPI_SUCCESS; }
+
+int MPI_Barrier(MPI_Comm) {
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
+  if (dest == MPI_PROC_NULL) return MPI_SUCCESS;
+  Mailbox &mailbox = *mailboxes[dest];
+  {
+    std::lock_guard<std::mutex> lock(mailbox.mutex);
+    mailbox.messages.push_back({world_rank, tag, comm, pack(buf, count, datatype)});
+  }
+  mailbox.arrived.notify_all();
+  return MPI_SUCCESS;
+}
+
+static int receive(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  if (source == MPI_PROC_NULL) return MPI_SUCCESS;
+  Mailbox &mailbox = *mailboxes[world_rank];
+  std::unique_lock<std::mutex> lock(mailbox.mutex);
+  std::deque<Message>::iterator match;
+  mailbox.arrived.wait(lock, [&] {
+    match = std::find_if(mailbox.messages.begin(), mailbox.messages.end(),
+                         [&](const Message &message) { return message.source == source && message.tag == tag && message.comm == comm; });
+    return match != mailbox.messages.end();
+  });
+
+  int rc = static_cast<long>(match->data.size()) > unpack(buf, count, datatype, match->data) ? MPI_ERR_COUNT : MPI_SUCCESS;
+  mailbox.messages.erase(match);
+  if (status) *status = {source, tag, rc};
+  return rc;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+  return receive(buf, count, datatype, source, tag, comm, status);
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm, MPI_Request *request) {
+  *request = new MPIThreadsRequest{nullptr, 0, datatype, dest, tag, comm, false};
+  return MPI_Send(buf, count, datatype, dest, tag, comm);
+}
+
+// Receives complete in MPI_Wait, which is where a real MPI would block for them
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request *request) {
+  *request = new MPIThreadsRequest{buf, count, datatype, source, tag, comm, true};
+  return MPI_SUCCESS;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+  if (*request == MPI_REQUEST_NULL) return MPI_SUCCESS;
+  MPIThreadsRequest *pending = *request;
+  int rc = MPI_SUCCESS;
+  if (pending->recv) {
+    rc = receive(pending->buffer, pending->count, pending->datatype, pending->source, pending->tag, pending->comm, status);
+  }
+  for (const MPIThreadsRequest &part : pending->parts) {
+    int part_rc = receive(part.buffer, part.count, part.datatype, part.source, part.tag, part.comm, MPI_STATUS_IGNORE);
+    if (part_rc != MPI_SUCCESS) rc = part_rc;
+  }
+  delete pending;
+  *request = MPI_REQUEST_NULL;
+  return rc;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]) {
+  int rc = MPI_SUCCESS;
+  for (int ii = 0; ii < count; ++ii) {
+    int request_rc = MPI_Wait(&requests[ii], statuses ? &statuses[ii] : MPI_STATUS_IGNORE);
+    if (request_rc != MPI_SUCCESS) rc = request_rc;
+  }
+  return rc;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm) {
+  collective_buffers[world_rank] = sendbuf;
+  threads_barrier();
+  if (world_rank == root) reduce_published(recvbuf, count, datatype, op);
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm) {
+  collective_buffers[world_rank] = sendbuf;
+  threads_barrier();
+  reduce_published(recvbuf, count, datatype, op);
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+int MPI_Gather(const void *sendbuf, int, MPI_Datatype, void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm) {
+  collective_buffers[world_rank] = sendbuf;
+  threads_barrier();
+  if (world_rank == root) {
+    int bytes = recvcount * datatype_size(recvtype);
+    for (int rr = 0; rr < world_size; ++rr) {
+      std::memcpy(static_cast<char *>(recvbuf) + rr * bytes, collective_buffers[rr], bytes);
+    }
+  }
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+int MPI_Gatherv(const void *sendbuf, int, MPI_Datatype, void *recvbuf, const int *recvcounts, const int *displs, MPI_Datatype recvtype,
+                int root, MPI_Comm) {
+  collective_buffers[world_rank] = sendbuf;
+  threads_barrier();
+  if (world_rank == root) {
+    int size = datatype_size(recvtype);
+    for (int rr = 0; rr < world_size; ++rr) {
+      if (recvcounts[rr]) std::memcpy(static_cast<char *>(recvbuf) + displs[rr] * size, collective_buffers[rr], recvcounts[rr] * size);
+    }
+  }
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm) {
+  collective_buffers[world_rank] = buffer;
+  threads_barrier();
+  if (world_rank != root) std::memcpy(buffer, collective_buffers[root], count * datatype_size(datatype));
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+int MPI_Allgather(const void *sendbuf, int, MPI_Datatype, void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm) {
+  collective_buffers[world_rank] = sendbuf;
+  threads_barrier();
+  int bytes = recvcount * datatype_size(recvtype);
+  for (int rr = 0; rr < world_size; ++rr) {
+    std::memcpy(static_cast<char *>(recvbuf) + rr * bytes, collective_buffers[rr], bytes);
+  }
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+// Each rank reads its slice straight out of every other rank's send buffer
+int MPI_Alltoallv(const void *sendbuf, const int *, const int *sdispls, MPI_Datatype sendtype, void *recvbuf, const int *recvcounts,
+                  const int *rdispls, MPI_Datatype recvtype, MPI_Comm) {
+  collective_buffers[world_rank] = sendbuf;
+  collective_displs[world_rank] = sdispls;
+  threads_barrier();
+  int send_size = datatype_size(sendtype), recv_size = datatype_size(recvtype);
+  for (int rr = 0; rr < world_size; ++rr) {
+    if (!recvcounts[rr]) continue;
+    const char *slice = static_cast<const char *>(collective_buffers[rr]) + collective_displs[rr][world_rank] * send_size;
+    std::memcpy(static_cast<char *>(recvbuf) + rdispls[rr] * recv_size, slice, recvcounts[rr] * recv_size);
+  }
+  threads_barrier();
+  return MPI_SUCCESS;
+}
+
+// Neighbours in the order of the cartesian topology, the source then the destination of a shift along each dimension. Each slot
+// sends eagerly and the request receives from the opposite slot of every neighbour
+int MPI_Ineighbor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype, void *recvbuf,
+                            const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm, MPI_Request *request) {
+  int neighbours[2 * 2];
+  MPI_Cart_shift(comm, 0, 1, &neighbours[0], &neighbours[1]);
+  MPI_Cart_shift(comm, 1, 1, &neighbours[2], &neighbours[3]);
+
+  long send_extent = datatype_extent(sendtype), recv_extent = datatype_extent(recvtype);
+  *request = new MPIThreadsRequest{nullptr, 0, recvtype, MPI_PROC_NULL, 0, comm, false};
+  for (int nn = 0; nn < 2 * 2; ++nn) {
+    if (neighbours[nn] == MPI_PROC_NULL) continue;
+    MPI_Send(static_cast<const char *>(sendbuf) + sdispls[nn] * send_extent, sendcounts[nn], sendtype, neighbours[nn],
+             MPI_THREADS_NEIGHBOR_TAG - nn, comm);
+    (*request)->parts.push_back({static_cast<char *>(recvbuf) + rdispls[nn] * recv_extent, recvcounts[nn], recvtype, neighbours[nn],
+                                 MPI_THREADS_NEIGHBOR_TAG - (nn ^ 1), comm, true});
+  }
+  return MPI_SUCCESS;
+}
+
+int MPI_Get_address(const void *location, MPI_Aint *address) {
+  *address = reinterpret_cast<MPI_Aint>(location);
+  return MPI_SUCCESS;
+}
+
+int MPI_Type_vector(int count, int blocklength, int stride, MPI_Datatype oldtype, MPI_Datatype *newtype) {
+  long old_extent = datatype_extent(oldtype);
+  DerivedType type{{}, (static_cast<long>(count - 1) * stride + blocklength) * old_extent};
+  for (int ii = 0; ii < count; ++ii) {
+    flatten(oldtype, ii * stride * old_extent, blocklength, type.blocks);
+  }
+  *newtype = add_derived_type(std::move(type));
+  return MPI_SUCCESS;
+}
+
+int MPI_Type_create_struct(int count, const int blocklengths[], const MPI_Aint displacements[], const MPI_Datatype types[],
+                           MPI_Datatype *newtype) {
+  DerivedType type{{}, 0};
+  for (int ii = 0; ii < count; ++ii) {
+    flatten(types[ii], displacements[ii], blocklengths[ii], type.blocks);
+    type.extent = std::max(type.extent, displacements[ii] + blocklengths[ii] * datatype_extent(types[ii]));
+  }
+  *newtype = add_derived_type(std::move(type));
+  return MPI_SUCCESS;
+}
+
+int MPI_Type_commit(MPI_Datatype *) { return MPI_SUCCESS; }
+
+int MPI_Type_free(MPI_Datatype *datatype) {
+  *datatype = MPI_DATATYPE_NULL;
+  return MPI_SUCCESS;
+}
+
+// Only the trivial split is supported, every rank staying in one group that is the world itself
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm) {
+  std::vector<int> colors(world_size), keys(world_size);
+  MPI_Allgather(&color, 1, MPI_INT, colors.data(), 1, MPI_INT, comm);
+  MPI_Allgather(&key, 1, MPI_INT, keys.data(), 1, MPI_INT, comm);
+  if (std::count(colors.begin(), colors.end(), color) != world_size) {
+    std::fprintf(stderr, "MPI threads: splitting into several communicators is not supported\n");
+    std::exit(EXIT_FAILURE);
+  }
+  if (!std::is_sorted(keys.begin(), keys.end())) {
+    std::fprintf(stderr, "MPI threads: reordering ranks is not supported\n");
+    std::exit(EXIT_FAILURE);
+  }
+  *newcomm = comm;
+  return MPI_SUCCESS;
+}
+
+// Every thread runs on the same node
+int MPI_Comm_split_type(MPI_Comm comm, int, int, MPI_Info, MPI_Comm *newcomm) {
+  *newcomm = comm;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_free(MPI_Comm *comm) {
+  *comm = MPI_COMM_WORLD;
+  return MPI_SUCCESS;
+}
+
+// Every rank's segment of a window, threads share the address space so any rank can read or write another's. Post-start-complete-
+// wait epochs are counted per target and origin: targets count exposures posted and origins accesses completed, while origins
+// count the epochs they started and targets those they waited for
+struct ThreadsWindow {
+  std::vector<void *> segments;
+  std::vector<MPI_Aint> sizes;
+  std::vector<int> disp_units;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<std::vector<long>> posted;
+  std::vector<std::vector<long>> completed;
+  std::vector<std::vector<long>> started;
+  std::vector<std::vector<long>> waited;
+  std::vector<std::vector<int>> exposure_groups;
+  std::vector<std::vector<int>> access_groups;
+};
+
+// Windows are created collectively in the same order on every rank, which numbers them alike, and are never reused once freed
+static std::mutex windows_mutex;
+static std::deque<ThreadsWindow> windows;
+static thread_local int windows_created = 0;
+
+static ThreadsWindow &threads_window(MPI_Win win) {
+  std::lock_guard<std::mutex> lock(windows_mutex);
+  return windows[win - 1];
+}
+
+static void *allocate_window(MPI_Aint size, int disp_unit, MPI_Win *win) {
+  *win = ++windows_created;
+  {
+    std::lock_guard<std::mutex> lock(windows_mutex);
+    if (windows.size() < static_cast<size_t>(*win)) {
+      ThreadsWindow &window = windows.emplace_back();
+      window.segments.assign(world_size, nullptr);
+      window.sizes.assign(world_size, 0);
+      window.disp_units.assign(world_size, 1);
+      for (auto *counters : {&window.posted, &window.completed, &window.started, &window.waited}) {
+        counters->assign(world_size, std::vector<long>(world_size, 0));
+      }
+      window.exposure_groups.resize(world_size);
+      window.access_groups.resize(world_size);
+    }
+  }
+  ThreadsWindow &window = threads_window(*win);
+  void *segment = std::calloc(std::max<MPI_Aint>(size, 1), disp_unit);
+  window.segments[world_rank] = segment;
+  window.sizes[world_rank] = size;
+  window.disp_units[world_rank] = disp_unit;
+  threads_barrier();
+  return segment;
+}
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info, MPI_Comm, void *baseptr, MPI_Win *win) {
+  *static_cast<void **>(baseptr) = allocate_window(size, disp_unit, win);
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info, MPI_Comm, void *baseptr, MPI_Win *win) {
+  *static_cast<void **>(baseptr) = allocate_window(size, disp_unit, win);
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr) {
+  ThreadsWindow &window = threads_window(win);
+  *size = window.sizes[rank];
+  *disp_unit = window.disp_units[rank];
+  *static_cast<void **>(baseptr) = window.segments[rank];
+  return MPI_SUCCESS;
+}
+
+// Nobody may still be reading a segment once every rank has called free
+int MPI_Win_free(MPI_Win *win) {
+  threads_barrier();
+  ThreadsWindow &window = threads_window(*win);
+  std::free(window.segments[world_rank]);
+  window.segments[world_rank] = nullptr;
+  threads_barrier();
+  *win = 0;
+  return MPI_SUCCESS;
+}
+
+int MPI_Comm_group(MPI_Comm, MPI_Group *group) {
+  *group = new MPIThreadsGroup{};
+  for (int rr = 0; rr < world_size; ++rr) {
+    (*group)->ranks.push_back(rr);
+  }
+  return MPI_SUCCESS;
+}
+
+int MPI_Group_incl(MPI_Group group, int n, const int ranks[], MPI_Group *newgroup) {
+  *newgroup = new MPIThreadsGroup{};
+  for (int ii = 0; ii < n; ++ii) {
+    (*newgroup)->ranks.push_back(group->ranks[ranks[ii]]);
+  }
+  return MPI_SUCCESS;
+}
+
+int MPI_Group_translate_ranks(MPI_Group group1, int n, const int ranks1[], MPI_Group group2, int ranks2[]) {
+  for (int ii = 0; ii < n; ++ii) {
+    auto found = std::find(group2->ranks.begin(), group2->ranks.end(), group1->ranks[ranks1[ii]]);
+    ranks2[ii] = found == group2->ranks.end() ? MPI_UNDEFINED : static_cast<int>(found - group2->ranks.begin());
+  }
+  return MPI_SUCCESS;
+}
+
+int MPI_Group_free(MPI_Group *group) {
+  delete *group;
+  *group = MPI_GROUP_NULL;
+  return MPI_SUCCESS;
+}
+
+// Exposes this rank's segment to the origins in the group
+int MPI_Win_post(MPI_Group group, int, MPI_Win win) {
+  ThreadsWindow &window = threads_window(win);
+  {
+    std::lock_guard<std::mutex> lock(window.mutex);
+    window.exposure_groups[world_rank] = group->ranks;
+    for (int origin : group->ranks) {
+      ++window.posted[world_rank][origin];
+    }
+  }
+  window.changed.notify_all();
+  return MPI_SUCCESS;
+}
+
+// Waits until every target in the group has exposed its segment to this rank
+int MPI_Win_start(MPI_Group group, int, MPI_Win win) {
+  ThreadsWindow &window = threads_window(win);
+  std::unique_lock<std::mutex> lock(window.mutex);
+  window.access_groups[world_rank] = group->ranks;
+  for (int target : group->ranks) {
+    long epoch = ++window.started[target][world_rank];
+    window.changed.wait(lock, [&] { return window.posted[target][world_rank] >= epoch; });
+  }
+  return MPI_SUCCESS;
+}
+
+// Writes straight into the target's segment, which start has made sure is exposed
+int MPI_Put(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank, MPI_Aint target_disp,
+            int target_count, MPI_Datatype target_datatype, MPI_Win win) {
+  ThreadsWindow &window = threads_window(win);
+  char *target = static_cast<char *>(window.segments[target_rank]) + target_disp * window.disp_units[target_rank];
+  unpack(target, target_count, target_datatype, pack(origin_addr, origin_count, origin_datatype));
+  return MPI_SUCCESS;
+}
+
+int MPI_Win_complete(MPI_Win win) {
+  ThreadsWindow &window = threads_window(win);
+  {
+    std::lock_guard<std::mutex> lock(window.mutex);
+    for (int target : window.access_groups[world_rank]) {
+      ++window.completed[target][world_rank];
+    }
+  }
+  window.changed.notify_all();
+  return MPI_SUCCESS;
+}
+
+// Waits until every origin this rank's segment was exposed to has completed its accesses
+int MPI_Win_wait(MPI_Win win) {
+  ThreadsWindow &window = threads_window(win);
+  std::unique_lock<std::mutex> lock(window.mutex);
+  for (int origin : window.exposure_groups[world_rank]) {
+    long epoch = ++window.waited[world_rank][origin];
+    window.changed.wait(lock, [&] { return window.completed[world_rank][origin] >= epoch; });
+  }
+  return MPI_SUCCESS;
+}
+
+// Every rank passes the same dims, the first to arrive records them
+int MPI_Cart_create(MPI_Comm, int ndims, const int dims[], const int[], int, MPI_Comm *comm_cart) {
+  if (ndims != 2 || dims[0] * dims[1] != world_size) {
+    std::fprintf(stderr, "MPI threads: cartesian grid %dx%d does not match %d ranks\n", dims[0], ndims > 1 ? dims[1] : 1, world_size);
+    std::exit(EXIT_FAILURE);
+  }
+  {
+    std::lock_guard<std::mutex> lock(collective_mutex);
+    cart_dims[0] = dims[0];
+    cart_dims[1] = dims[1];
+  }
+  threads_barrier();
+  *comm_cart = MPI_THREADS_CART_COMM;
+  return MPI_SUCCESS;
+}
+
+// Row-major rank order, as MPI specifies for cartesian communicators
+int MPI_Cart_coords(MPI_Comm, int rank, int, int coords[]) {
+  coords[0] = rank / cart_dims[1];
+  coords[1] = rank % cart_dims[1];
+  return MPI_SUCCESS;
+}
+
+int MPI_Cart_shift(MPI_Comm comm, int direction, int disp, int *rank_source, int *rank_dest) {
+  int coords[2];
+  MPI_Cart_coords(comm, world_rank, 2, coords);
+  auto shifted = [&](int offset) {
+    int shifted_coords[2] = {coords[0], coords[1]};
+    shifted_coords[direction] += offset;
+    if (shifted_coords[direction] < 0 || shifted_coords[direction] >= cart_dims[direction]) return MPI_PROC_NULL;
+    return shifted_coords[0] * cart_dims[1] + shifted_coords[1];
+  };
+  *rank_source = shifted(-disp);
+  *rank_dest = shifted(disp);
+  return MPI_SUCCESS;
+}
+
+// No rank ever fails
+int MPIX_Comm_failure_ack(MPI_Comm) { return MPI_SUCCESS; }
+
+#endif
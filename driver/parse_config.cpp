@@ -1,9 +1,13 @@
 #include "application.h"
+#include "comms.h"
 #include "shared.h"
 #include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <string>
+#include <vector>
 
+void read_config_file(FILE *tea_in, Settings &settings, State **states);
 int read_states(FILE *tea_in, Settings &settings, State **states);
 void read_settings(FILE *tea_in, Settings &settings);
 void read_value(const char *line, const char *word, char *value);
@@ -11,14 +15,91 @@ bool starts_with(const char *word, const char *line);
 bool starts_get_double(const char *key, const char *line, char *word, double *value);
 bool starts_get_int(const char *key, const char *line, char *word, int *value);
 
+// The text of the configuration file, read by the master alone and broadcast so that the other ranks stay off the filesystem
+static std::string read_deck(Settings &settings) {
+  std::string deck;
+  if (settings.rank == MASTER) {
+    FILE *tea_in = fopen(settings.tea_in_filename, "r");
+    if (!tea_in) {
+      die(__LINE__, __FILE__, "Could not open input file %s\n", settings.tea_in_filename);
+    }
+    char buffer[4096];
+    for (size_t read; (read = fread(buffer, 1, sizeof(buffer), tea_in)) > 0;) {
+      deck.append(buffer, read);
+    }
+    fclose(tea_in);
+  }
+  broadcast_over_ranks(settings, deck);
+  return deck;
+}
+
+// Parses configuration text as if read from a file
+static void read_config_text(std::string &config, Settings &settings, State **states) {
+  config += "\n";
+  FILE *config_in = fmemopen(&config[0], config.size(), "r");
+  if (!config_in) {
+    die(__LINE__, __FILE__, "Could not read the input file %s\n", settings.tea_in_filename);
+  }
+  read_config_file(config_in, settings, states);
+  fclose(config_in);
+}
+
 // Read configuration file
 void read_config(Settings &settings, State **states) {
-  // Open the configuration file
-  FILE *tea_in = fopen(settings.tea_in_filename, "r");
+  std::string deck = read_deck(settings);
+  read_config_text(deck, settings, states);
+}
+
+// The key of a configuration line, up to the first space or '='
+static std::string config_key(const char *line) {
+  while (isspace(*line)) ++line;
+  const char *end = line;
+  while (*end && !isspace(*end) && *end != '=') ++end;
+  return std::string(line, end);
+}
+
+// Read the configuration file with some of its lines replaced, overrides holding one 'key=value' line per setting
+void read_config_overrides(Settings &settings, State **states, const char *overrides) {
+  std::string deck = read_deck(settings) + "\n";
+  FILE *tea_in = fmemopen(&deck[0], deck.size(), "r");
   if (!tea_in) {
-    die(__LINE__, __FILE__, "Could not open input file %s\n", settings.tea_in_filename);
+    die(__LINE__, __FILE__, "Could not read the input file %s\n", settings.tea_in_filename);
+  }
+
+  std::vector<std::string> override_lines;
+  for (const char *line = overrides; *line;) {
+    const char *end = std::strchr(line, '\n');
+    override_lines.emplace_back(line, end ? end : line + std::strlen(line));
+    line = end ? end + 1 : line + std::strlen(line);
+  }
+  std::vector<bool> used(override_lines.size(), false);
+
+  // An overridden key replaces the deck line in place, so that guards on defaults still see a single value
+  std::string config;
+  size_t len = 0;
+  char *line = nullptr;
+  while (getline(&line, &len, tea_in) != EOF) {
+    std::string key = config_key(line);
+    bool replaced = false;
+    for (size_t oo = 0; oo < override_lines.size() && !replaced; ++oo) {
+      if (!key.empty() && config_key(override_lines[oo].c_str()) == key) {
+        config += override_lines[oo] + "\n";
+        used[oo] = replaced = true;
+      }
+    }
+    if (!replaced) config += line;
   }
+  free(line);
+  fclose(tea_in);
+
+  for (size_t oo = 0; oo < override_lines.size(); ++oo) {
+    if (!used[oo]) config += "\n" + override_lines[oo];
+  }
+  read_config_text(config, settings, states);
+}
 
+// Reads the settings and states of an open configuration
+void read_config_file(FILE *tea_in, Settings &settings, State **states) {
   // Read all of the settings from the config
   read_settings(tea_in, settings);
   rewind(tea_in);
@@ -26,12 +107,44 @@ void read_config(Settings &settings, State **states) {
   // Read in the states
   settings.num_states = read_states(tea_in, settings, states);
 
-  fclose(tea_in);
+  if (settings.visit_downsample < 1) {
+    die(__LINE__, __FILE__, "visit_downsample must be at least 1, got %d\n", settings.visit_downsample);
+  }
+
+#ifndef ENABLE_ZLIB
+  if (settings.visit_format == VisitFormat::ZLIB) {
+    print_and_log(settings, "Warning: built without zlib support, falling back to uncompressed binary VTK output\n");
+    settings.visit_format = VisitFormat::RAW;
+  }
+#endif
+
+  // Rebalancing reallocates the chunks and so finalises and initialises the kernels again
+  if (settings.rebalance_steps && !settings.model_reinitialisable) {
+    print_and_log(settings, "Warning: %s cannot reinitialise its kernels, ignoring rebalance_steps\n", settings.model_name.c_str());
+    settings.rebalance_steps = 0;
+  }
+#ifdef DIFFUSE_OVERLOAD
+  if (settings.rebalance_steps) {
+    print_and_log(settings, "Warning: the OpenMP target driver runs its own loop without rebalancing, ignoring rebalance_steps\n");
+    settings.rebalance_steps = 0;
+  }
+#endif
+
+  // Only the master checks results
+  if (settings.check_result && settings.rank == MASTER) {
+    read_test_problems(settings);
+  }
 
   print_to_log(settings, "Solution Parameters:\n");
   print_to_log(settings, "\tdt_init = %f\n", settings.dt_init);
   print_to_log(settings, "\tend_time = %f\n", settings.end_time);
   print_to_log(settings, "\tend_step = %d\n", settings.end_step);
+  print_to_log(settings, "\tadaptive_timestep = %d\n", settings.adaptive_timestep);
+  if (settings.adaptive_timestep) {
+    print_to_log(settings, "\ttimestep_min = %f\n", settings.timestep_min);
+    print_to_log(settings, "\ttimestep_max = %f\n", settings.timestep_max);
+    print_to_log(settings, "\ttimestep_target_iterations = %d\n", settings.timestep_target_iterations);
+  }
   print_to_log(settings, "\tgrid_x_min = %f\n", settings.grid_x_min);
   print_to_log(settings, "\tgrid_y_min = %f\n", settings.grid_y_min);
   print_to_log(settings, "\tgrid_x_max = %f\n", settings.grid_x_max);
@@ -44,11 +157,30 @@ void read_config(Settings &settings, State **states) {
   print_to_log(settings, "\tmax_iters = %d\n", settings.max_iters);
   print_to_log(settings, "\teps = %f\n", settings.eps);
   print_to_log(settings, "\thalo_depth = %d\n", settings.halo_depth);
+  print_to_log(settings, "\thalo_exchange = %d\n", (int)settings.halo_exchange);
+  print_to_log(settings, "\trank_mapping = %d\n", (int)settings.rank_mapping);
+  print_to_log(settings, "\tshared_halos = %d\n", settings.shared_halos);
+  print_to_log(settings, "\tdatatype_halos = %d\n", settings.datatype_halos);
+  print_to_log(settings, "\trebalance_steps = %d\n", settings.rebalance_steps);
+  if (settings.rebalance_steps) {
+    print_to_log(settings, "\trebalance_threshold = %f\n", settings.rebalance_threshold);
+  }
   print_to_log(settings, "\tcheck_result = %d\n", settings.check_result);
   print_to_log(settings, "\tcoefficient = %d\n", settings.coefficient);
+  print_to_log(settings, "\tvolume_fraction_samples = %d\n", settings.volume_fraction_samples);
+  if (!settings.initial_state_file.empty()) {
+    print_to_log(settings, "\tinitial_state_file = %s\n", settings.initial_state_file.c_str());
+  }
   print_to_log(settings, "\tnum_chunks_per_rank = %d\n", settings.num_chunks_per_rank);
   print_to_log(settings, "\tsummary_frequency = %d\n", settings.summary_frequency);
+  print_to_log(settings, "\tverbosity = %d\n", settings.verbosity);
   print_to_log(settings, "\tvisit_frequency = %d\n", settings.visit_frequency);
+  print_to_log(settings, "\tvisit_format = %d\n", (int)settings.visit_format);
+  print_to_log(settings, "\tvisit_downsample = %d\n", settings.visit_downsample);
+  if (settings.visit_region) {
+    print_to_log(settings, "\tvisit_region = %f %f %f %f\n", settings.visit_region_x_min, settings.visit_region_y_min,
+                 settings.visit_region_x_max, settings.visit_region_y_max);
+  }
 
   print_to_log(settings, "\tft = %d\n", settings.ft);
   if (settings.ft) {
@@ -88,6 +220,9 @@ void read_settings(FILE *tea_in, Settings &settings) {
     if (starts_get_double("initial_timestep", line, word, &settings.dt_init)) continue;
     if (starts_get_double("end_time", line, word, &settings.end_time)) continue;
     if (starts_get_int("end_step", line, word, &settings.end_step)) continue;
+    if (starts_get_double("timestep_min", line, word, &settings.timestep_min)) continue;
+    if (starts_get_double("timestep_max", line, word, &settings.timestep_max)) continue;
+    if (starts_get_int("timestep_target_iterations", line, word, &settings.timestep_target_iterations)) continue;
     if (starts_get_double("xmin", line, word, &settings.grid_x_min)) continue;
     if (starts_get_double("ymin", line, word, &settings.grid_y_min)) continue;
     if (starts_get_double("xmax", line, word, &settings.grid_x_max)) continue;
@@ -96,6 +231,7 @@ void read_settings(FILE *tea_in, Settings &settings) {
     if (settings.grid_y_cells == DEF_GRID_Y_CELLS && starts_get_int("y_cells", line, word, &settings.grid_y_cells)) continue;
     if (starts_get_int("summary_frequency", line, word, &settings.summary_frequency)) continue;
     if (starts_get_int("visit_frequency", line, word, &settings.visit_frequency)) continue;
+    if (starts_get_int("visit_downsample", line, word, &settings.visit_downsample)) continue;
     if (starts_get_int("presteps", line, word, &settings.presteps)) continue;
     if (starts_get_int("ppcg_inner_steps", line, word, &settings.ppcg_inner_steps)) continue;
     if (starts_get_double("epslim", line, word, &settings.eps_lim)) continue;
@@ -103,6 +239,23 @@ void read_settings(FILE *tea_in, Settings &settings) {
     if (starts_get_double("eps", line, word, &settings.eps)) continue;
     if (starts_get_int("num_chunks_per_rank", line, word, &settings.num_chunks_per_rank)) continue;
     if (starts_get_int("halo_depth", line, word, &settings.halo_depth)) continue;
+    if (starts_get_int("volume_fraction_samples", line, word, &settings.volume_fraction_samples)) continue;
+    if (starts_with("initial_state_file", line)) {
+      read_value(line, "initial_state_file", word);
+      settings.initial_state_file = word;
+      continue;
+    }
+    if (starts_get_int("rebalance_steps", line, word, &settings.rebalance_steps)) continue;
+    if (starts_get_double("rebalance_threshold", line, word, &settings.rebalance_threshold)) continue;
+    if (settings.verbosity == DEF_VERBOSITY && starts_get_int("verbosity", line, word, &settings.verbosity)) continue;
+    if (starts_with("visit_region", line)) {
+      if (sscanf(line, " visit_region %lf %lf %lf %lf", &settings.visit_region_x_min, &settings.visit_region_y_min,
+                 &settings.visit_region_x_max, &settings.visit_region_y_max) != 4) {
+        die(__LINE__, __FILE__, "Expected 'visit_region xmin ymin xmax ymax'\n");
+      }
+      settings.visit_region = true;
+      continue;
+    }
     // Fault-tolerance config
     if (starts_get_int("with_ft_kill_x", line, word, &settings.with_ft_kill_x)) continue;
     if (starts_get_int("with_ft_kill_y", line, word, &settings.with_ft_kill_y)) continue;
@@ -119,6 +272,10 @@ void read_settings(FILE *tea_in, Settings &settings) {
       settings.error_switch = true;
       continue;
     }
+    if (starts_with("adaptive_timestep", line)) {
+      settings.adaptive_timestep = true;
+      continue;
+    }
     if (starts_with("preconditioner_on", line)) {
       settings.preconditioner = true;
       continue;
@@ -159,6 +316,50 @@ void read_settings(FILE *tea_in, Settings &settings) {
       settings.coefficient = RECIP_CONDUCTIVITY;
       continue;
     }
+    if (starts_with("use_vtk_ascii", line)) {
+      settings.visit_format = VisitFormat::ASCII;
+      continue;
+    }
+    if (starts_with("use_vtk_binary", line)) {
+      settings.visit_format = VisitFormat::RAW;
+      continue;
+    }
+    if (starts_with("use_vtk_zlib", line)) {
+      settings.visit_format = VisitFormat::ZLIB;
+      continue;
+    }
+    if (starts_with("use_blocking_halos", line)) {
+      settings.halo_exchange = HaloExchange::BLOCKING;
+      continue;
+    }
+    if (starts_with("use_nonblocking_halos", line)) {
+      settings.halo_exchange = HaloExchange::NONBLOCKING;
+      continue;
+    }
+    if (starts_with("use_neighbourhood_halos", line)) {
+      settings.halo_exchange = HaloExchange::NEIGHBOURHOOD;
+      continue;
+    }
+    if (starts_with("use_rma_halos", line)) {
+      settings.halo_exchange = HaloExchange::RMA;
+      continue;
+    }
+    if (starts_with("use_shared_halos", line)) {
+      settings.shared_halos = true;
+      continue;
+    }
+    if (starts_with("use_datatype_halos", line)) {
+      settings.datatype_halos = true;
+      continue;
+    }
+    if (starts_with("use_identity_rank_mapping", line)) {
+      settings.rank_mapping = RankMapping::IDENTITY;
+      continue;
+    }
+    if (starts_with("use_node_rank_mapping", line)) {
+      settings.rank_mapping = RankMapping::NODE;
+      continue;
+    }
     // Fault-tolerance config
     if (starts_with("use_ft_recv_static_strategy", line)) {
       settings.ft_recv_strategy = RecvFaultToleranceStrategy::STATIC;
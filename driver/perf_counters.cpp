@@ -0,0 +1,140 @@
+#include "perf_counters.h"
+#include "shared.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(ENABLE_PERF_COUNTERS) && defined(__linux__)
+  #include <dirent.h>
+  #include <linux/perf_event.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+bool perf_counters_active = false;
+
+#if defined(ENABLE_PERF_COUNTERS) && defined(__linux__)
+
+static const uint64_t perf_event_configs[PERF_COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                                PERF_COUNT_HW_CACHE_MISSES};
+static const char *perf_event_names[PERF_COUNTER_COUNT] = {"cycles", "instructions", "LLC misses"};
+
+// Position of each counter in a group read, -1 if the hardware does not support it
+static int perf_group_slot[PERF_COUNTER_COUNT];
+static int perf_group_size = 0;
+
+// One group of counters per thread, the first descriptor is the group leader
+static std::vector<std::vector<int>> perf_groups;
+
+static int perf_event_open(uint64_t config, pid_t tid, int group_fd) {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, group_fd, 0));
+}
+
+static std::vector<pid_t> perf_process_threads() {
+  std::vector<pid_t> threads;
+  DIR *tasks = opendir("/proc/self/task");
+  if (!tasks) return threads;
+  while (dirent *task = readdir(tasks)) {
+    if (task->d_name[0] != '.') threads.push_back(static_cast<pid_t>(std::atoi(task->d_name)));
+  }
+  closedir(tasks);
+  return threads;
+}
+
+static void perf_close_group(const std::vector<int> &group) {
+  for (int fd : group) {
+    close(fd);
+  }
+}
+
+void perf_counters_initialise(Settings &settings) {
+  std::vector<pid_t> threads = perf_process_threads();
+  pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+
+  // The calling thread decides which counters the hardware supports
+  std::vector<int> group;
+  for (int cc = 0; cc < PERF_COUNTER_COUNT; ++cc) {
+    int fd = perf_event_open(perf_event_configs[cc], self, group.empty() ? -1 : group.front());
+    perf_group_slot[cc] = fd < 0 ? -1 : static_cast<int>(group.size());
+    if (fd < 0) {
+      print_and_log(settings, "Warning: %s counter is not available: %s\n", perf_event_names[cc], strerror(errno));
+    } else {
+      group.push_back(fd);
+    }
+  }
+
+  if (group.empty()) {
+    print_and_log(settings, "Warning: no hardware counters could be opened, check /proc/sys/kernel/perf_event_paranoid\n");
+    return;
+  }
+  perf_group_size = static_cast<int>(group.size());
+  perf_groups.push_back(group);
+
+  for (pid_t thread : threads) {
+    if (thread == self) continue;
+
+    std::vector<int> thread_group;
+    for (int cc = 0; cc < PERF_COUNTER_COUNT; ++cc) {
+      if (perf_group_slot[cc] < 0) continue;
+      int fd = perf_event_open(perf_event_configs[cc], thread, thread_group.empty() ? -1 : thread_group.front());
+      if (fd < 0) break;
+      thread_group.push_back(fd);
+    }
+
+    // Threads may exit while being enumerated, only complete groups are kept
+    if (static_cast<int>(thread_group.size()) == perf_group_size) {
+      perf_groups.push_back(thread_group);
+    } else {
+      perf_close_group(thread_group);
+    }
+  }
+
+  print_and_log(settings, "Hardware counters on %zu threads:", perf_groups.size());
+  for (int cc = 0; cc < PERF_COUNTER_COUNT; ++cc) {
+    if (perf_group_slot[cc] >= 0) print_and_log(settings, " %s", perf_event_names[cc]);
+  }
+  print_and_log(settings, "\n");
+  perf_counters_active = true;
+}
+
+void perf_counters_finalise() {
+  perf_counters_active = false;
+  for (const std::vector<int> &group : perf_groups) {
+    perf_close_group(group);
+  }
+  perf_groups.clear();
+}
+
+bool perf_counter_available(PerfCounter counter) { return perf_counters_active && perf_group_slot[counter] >= 0; }
+
+void perf_counters_read(PerfSample *sample) {
+  *sample = {};
+
+  // Layout of a group read: number of events, time enabled, time running, then one value per event
+  uint64_t buffer[3 + PERF_COUNTER_COUNT];
+  for (const std::vector<int> &group : perf_groups) {
+    if (read(group.front(), buffer, sizeof(buffer)) <= 0) continue;
+    double scale = buffer[2] ? static_cast<double>(buffer[1]) / buffer[2] : 0.0;
+    for (int cc = 0; cc < PERF_COUNTER_COUNT; ++cc) {
+      if (perf_group_slot[cc] >= 0) sample->values[cc] += buffer[3 + perf_group_slot[cc]] * scale;
+    }
+  }
+}
+
+#else
+
+void perf_counters_initialise(Settings &) {}
+void perf_counters_finalise() {}
+bool perf_counter_available(PerfCounter) { return false; }
+void perf_counters_read(PerfSample *sample) { *sample = {}; }
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ *		HARDWARE PERFORMANCE COUNTERS
+ *		Counts hardware events with perf_event_open on every thread of the process, so that the
+ *		profiler can attribute them to each run_* kernel. Only built with ENABLE_PERF_COUNTERS on Linux.
+ */
+
+struct Settings;
+
+// Bytes moved from memory by each last-level cache miss
+#define PERF_CACHE_LINE_BYTES 64
+
+enum PerfCounter { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_COUNTER_COUNT };
+
+// Event counts summed over all counted threads, scaled up if the kernel multiplexed the counters
+struct PerfSample {
+  double values[PERF_COUNTER_COUNT];
+};
+
+extern bool perf_counters_active;
+
+// Opens the counters on every thread that exists at the time of the call, threads started later are not counted
+void perf_counters_initialise(Settings &settings);
+void perf_counters_finalise();
+
+bool perf_counter_available(PerfCounter counter);
+void perf_counters_read(PerfSample *sample);
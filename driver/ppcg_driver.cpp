@@ -7,6 +7,8 @@ void ppcg_inner_iterations(Chunk *chunks, Settings &settings);
 
 // Performs a full solve with the PPCG solver
 void ppcg_driver(Chunk *chunks, Settings &settings, double rx, double ry, double *error) {
+  START_PROFILING(settings.kernel_profile);
+
   int tt;
   double rro = 0.0;
   int num_ppcg_iters = 0;
@@ -45,9 +47,12 @@ void ppcg_driver(Chunk *chunks, Settings &settings, double rx, double ry, double
 
     if (fabs(*error) < settings.eps) break;
   }
+  settings.solve_iterations = tt;
+
+  print_and_log_at(settings, LOG_STEP, " CG: \t\t\t%d iterations\n", tt - num_ppcg_iters + 1);
+  print_and_log_at(settings, LOG_STEP, " PPCG: \t\t\t%d iterations (%d inner iterations per)\n", num_ppcg_iters, settings.ppcg_inner_steps);
 
-  print_and_log(settings, " CG: \t\t\t%d iterations\n", tt - num_ppcg_iters + 1);
-  print_and_log(settings, " PPCG: \t\t\t%d iterations (%d inner iterations per)\n", num_ppcg_iters, settings.ppcg_inner_steps);
+  STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
 // Invokes the PPCG initialisation kernels
@@ -0,0 +1,140 @@
+#include "profile_report.h"
+#include "comms.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Per-rank statistics of a single quantity
+struct RankStatistics {
+  double min;
+  double avg;
+  double max;
+  int max_rank;
+};
+
+static RankStatistics rank_statistics(const std::vector<double> &per_rank) {
+  auto [min, max] = std::minmax_element(per_rank.begin(), per_rank.end());
+  double avg = std::accumulate(per_rank.begin(), per_rank.end(), 0.0) / per_rank.size();
+  return {*min, avg, *max, static_cast<int>(max - per_rank.begin())};
+}
+
+// Max over average, 1.0 when perfectly balanced
+static double imbalance(const RankStatistics &stats) { return stats.avg > 0.0 ? stats.max / stats.avg : 1.0; }
+
+static void print_statistics(const RankStatistics &stats) {
+  printf("%12.03F%12.03F%12.03F%11.2Fx%10d\n", stats.min, stats.avg, stats.max, imbalance(stats), stats.max_rank);
+}
+
+// Gathers every rank's flat profile entries on the master, matched by name since ranks may not share the same regions
+void profile_report_ranks(Settings &settings) {
+  std::vector<ProfileEntry> entries = profiler_flat_entries(settings.kernel_profile);
+
+  // Top-level regions cover all profiled time without double counting nested ones
+  double total = 0.0;
+  for (const ProfileEntry &entry : profiler_tree_entries(settings.kernel_profile)) {
+    if (!entry.depth) total += entry.time;
+  }
+
+  int num_entries = static_cast<int>(entries.size());
+  std::string names;
+  std::vector<double> times;
+  std::vector<long> calls;
+  for (const ProfileEntry &entry : entries) {
+    names.append(entry.name).push_back('\0');
+    times.push_back(entry.time);
+    calls.push_back(entry.calls);
+  }
+  int names_len = static_cast<int>(names.size());
+
+  bool is_master = settings.rank == MASTER;
+  int num_ranks = settings.num_ranks;
+  std::vector<int> rank_num_entries(is_master ? num_ranks : 0);
+  std::vector<int> rank_names_len(is_master ? num_ranks : 0);
+  std::vector<double> rank_totals(is_master ? num_ranks : 0);
+  MPI_Gather(&num_entries, 1, MPI_INT, rank_num_entries.data(), 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+  MPI_Gather(&names_len, 1, MPI_INT, rank_names_len.data(), 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+  MPI_Gather(&total, 1, MPI_DOUBLE, rank_totals.data(), 1, MPI_DOUBLE, MASTER, MPI_COMM_WORLD);
+
+  std::vector<int> entry_displs(is_master ? num_ranks : 0);
+  std::vector<int> names_displs(is_master ? num_ranks : 0);
+  if (is_master) {
+    std::exclusive_scan(rank_num_entries.begin(), rank_num_entries.end(), entry_displs.begin(), 0);
+    std::exclusive_scan(rank_names_len.begin(), rank_names_len.end(), names_displs.begin(), 0);
+  }
+
+  int all_entries = is_master ? entry_displs.back() + rank_num_entries.back() : 0;
+  int all_names_len = is_master ? names_displs.back() + rank_names_len.back() : 0;
+  std::vector<char> all_names(all_names_len);
+  std::vector<double> all_times(all_entries);
+  std::vector<long> all_calls(all_entries);
+  MPI_Gatherv(names.data(), names_len, MPI_CHAR, all_names.data(), rank_names_len.data(), names_displs.data(), MPI_CHAR, MASTER,
+              MPI_COMM_WORLD);
+  MPI_Gatherv(times.data(), num_entries, MPI_DOUBLE, all_times.data(), rank_num_entries.data(), entry_displs.data(), MPI_DOUBLE,
+              MASTER, MPI_COMM_WORLD);
+  MPI_Gatherv(calls.data(), num_entries, MPI_LONG, all_calls.data(), rank_num_entries.data(), entry_displs.data(), MPI_LONG, MASTER,
+              MPI_COMM_WORLD);
+
+  if (!is_master) return;
+
+  // Regions in order of first appearance, ranks missing a region count as zero time
+  std::vector<std::string> region_names;
+  std::unordered_map<std::string, int> region_index;
+  std::vector<std::vector<double>> region_times;
+  std::vector<long> region_max_calls;
+  for (int rr = 0; rr < num_ranks; ++rr) {
+    const char *name = all_names.data() + names_displs[rr];
+    for (int ee = entry_displs[rr]; ee < entry_displs[rr] + rank_num_entries[rr]; ++ee) {
+      auto found = region_index.find(name);
+      if (found == region_index.end()) {
+        found = region_index.emplace(name, static_cast<int>(region_names.size())).first;
+        region_names.emplace_back(name);
+        region_times.emplace_back(num_ranks, 0.0);
+        region_max_calls.push_back(0);
+      }
+      region_times[found->second][rr] = all_times[ee];
+      region_max_calls[found->second] = std::max(region_max_calls[found->second], all_calls[ee]);
+      name += std::strlen(name) + 1;
+    }
+  }
+
+  printf("\n -------------------------------------------------------------\n");
+  printf("\n Cross-Rank Profiling Results (%d ranks):\n\n", num_ranks);
+  printf(" %-30s%10s%12s%12s%12s%12s%10s\n", "Kernel Name", "Max calls", "Min (s)", "Avg (s)", "Max (s)", "Imbalance", "Max rank");
+  for (size_t ii = 0; ii < region_names.size(); ++ii) {
+    printf(" %-30s%10ld", region_names[ii].c_str(), region_max_calls[ii]);
+    print_statistics(rank_statistics(region_times[ii]));
+  }
+
+  // Split the profiled time of each rank into waiting on other ranks and everything else
+  std::vector<double> rank_comm(num_ranks, 0.0);
+  for (const char *comm_region : PROFILE_REPORT_COMM_REGIONS) {
+    auto found = region_index.find(comm_region);
+    if (found == region_index.end()) continue;
+    for (int rr = 0; rr < num_ranks; ++rr) {
+      rank_comm[rr] += region_times[found->second][rr];
+    }
+  }
+  std::vector<double> rank_compute(num_ranks);
+  for (int rr = 0; rr < num_ranks; ++rr) {
+    rank_compute[rr] = rank_totals[rr] - rank_comm[rr];
+  }
+
+  printf("\n %-30s%10s%12s%12s%12s%12s%10s\n", "Time Split", "", "Min (s)", "Avg (s)", "Max (s)", "Imbalance", "Max rank");
+  printf(" %-30s%10s", "Total profiled", "");
+  print_statistics(rank_statistics(rank_totals));
+  printf(" %-30s%10s", "Compute", "");
+  print_statistics(rank_statistics(rank_compute));
+  printf(" %-30s%10s", "Communication wait", "");
+  print_statistics(rank_statistics(rank_comm));
+
+  RankStatistics compute = rank_statistics(rank_compute);
+  RankStatistics totals = rank_statistics(rank_totals);
+  printf("\n Slowest compute rank: %d, %.1F%% above average.\n", compute.max_rank,
+         compute.avg > 0.0 ? (compute.max / compute.avg - 1.0) * 100.0 : 0.0);
+  printf(" Communication wait: %.1F%% of the average profiled time.\n",
+         totals.avg > 0.0 ? rank_statistics(rank_comm).avg / totals.avg * 100.0 : 0.0);
+  printf("\n -------------------------------------------------------------\n\n");
+}
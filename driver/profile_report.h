@@ -0,0 +1,24 @@
+#pragma once
+
+#include "settings.h"
+
+/*
+ *		CROSS-RANK PROFILE REPORT
+ *		Gathers the kernel profile of every rank on the master, collective over all ranks.
+ */
+
+// Regions whose time is spent waiting on other ranks rather than computing
+#define PROFILE_REPORT_COMM_REGIONS                                                                                                 \
+  {"send_recv_message", "send_recv_halo_fields", "neighbour_halo_start", "neighbour_halo_wait", "rma_halo_start", "rma_halo_wait",  \
+   "shared_halo_send_buffer", "shared_halo_recv_buffer", "sum_over_ranks", "min_over_ranks", "max_over_ranks",                      \
+   "sum_array_over_ranks", "exchange_over_ranks", "broadcast_over_ranks"}
+
+void profile_report_ranks(Settings &settings);
+
+#ifdef ENABLE_PROFILING
+  #define PRINT_RANK_PROFILING_RESULTS(settings) profile_report_ranks(settings)
+#else
+  #define PRINT_RANK_PROFILING_RESULTS(settings) \
+    do {                                         \
+    } while (false)
+#endif
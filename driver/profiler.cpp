@@ -1,105 +1,311 @@
 #include "profiler.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <cstring>
+#include <mutex>
+#include <unordered_map>
 
-#define tealeaf_strmatch(a, b) (strcmp(a, b) == 0)
+#ifdef __APPLE__
+  #include <mach/mach.h>
+  #include <mach/mach_time.h>
+#else
+  #include <ctime>
+#endif
+
+// A region at a given call path
+struct ProfileNode {
+  int region;
+  int parent;
+  long calls;
+  double time;
+  double min_time;
+  double max_time;
+  bool counted;
+  PerfSample counters;
+};
+
+// An open region, the node stays unresolved (-1) until the end of an unnamed timer
+struct ProfileFrame {
+  int node;
+  double start;
+  PerfSample counters;
+};
+
+struct ProfileThread {
+  std::vector<ProfileNode> nodes;
+  std::unordered_map<uint64_t, int> children;
+  std::vector<ProfileFrame> stack;
+};
 
-struct Profile *profiler_initialise() {
-  auto *profile = static_cast<Profile *>(std::malloc(sizeof(Profile)));
-  std::memset(profile, 0, sizeof(Profile));
-  return profile;
+static std::mutex profiler_regions_mutex;
+static std::vector<std::string> profiler_region_names;
+static std::unordered_map<std::string, int> profiler_region_ids;
+
+static std::atomic<int> profiler_thread_count{0};
+static thread_local int profiler_thread_index = -1;
+
+double profiler_now() {
+#ifdef __APPLE__
+  return mach_absolute_time() * 1.0E-9;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1.0E-9;
+#endif
 }
 
+Profile *profiler_initialise() { return new Profile{}; }
+
 void profiler_finalise(Profile **profile) {
-  std::free(*profile);
+  for (ProfileThread *thread : (*profile)->threads) {
+    delete thread;
+  }
+  delete *profile;
   *profile = nullptr;
 }
 
-// Internally start the profiling timer
-void profiler_start_timer(Profile *profile) {
-#ifdef __APPLE__
-  profile->profiler_start = mach_absolute_time();
-#else
-  clock_gettime(CLOCK_MONOTONIC, &profile->profiler_start);
-#endif
+int profiler_intern_region(const char *name) {
+  std::lock_guard<std::mutex> lock(profiler_regions_mutex);
+  auto found = profiler_region_ids.find(name);
+  if (found != profiler_region_ids.end()) {
+    return found->second;
+  }
+
+  int region = static_cast<int>(profiler_region_names.size());
+  profiler_region_names.emplace_back(name);
+  profiler_region_ids.emplace(name, region);
+  return region;
 }
 
-// Internally end the profiling timer and store results
-void profiler_end_timer(Profile *profile, const char *entry_name) {
-#ifdef __APPLE__
-  profile->profiler_end = mach_absolute_time();
-#else
-  clock_gettime(CLOCK_MONOTONIC, &profile->profiler_end);
-#endif
+std::string profiler_region_name(int region) {
+  std::lock_guard<std::mutex> lock(profiler_regions_mutex);
+  return profiler_region_names[region];
+}
 
-  // Check if an entry exists
-  int ii;
-  for (ii = 0; ii < profile->profiler_entry_count; ++ii) {
-    if (tealeaf_strmatch(profile->profiler_entries[ii].name, entry_name)) {
-      break;
-    }
+// Accumulates the events counted between two samples
+static void profiler_add_counters(PerfSample *total, const PerfSample &end, const PerfSample &start) {
+  for (int cc = 0; cc < PERF_COUNTER_COUNT; ++cc) {
+    total->values[cc] += end.values[cc] - start.values[cc];
+  }
+}
+
+// Each thread only ever touches its own slot
+static ProfileThread *profiler_thread(Profile *profile) {
+  if (profiler_thread_index < 0) {
+    profiler_thread_index = profiler_thread_count++;
   }
 
   // Don't overrun
-  if (ii >= PROFILER_MAX_ENTRIES) {
-    printf("Attempted to profile too many entries, maximum is %d\n", PROFILER_MAX_ENTRIES);
+  if (profiler_thread_index >= PROFILER_MAX_THREADS) {
+    printf("Attempted to profile too many threads, maximum is %d\n", PROFILER_MAX_THREADS);
     exit(1);
   }
 
-  // Create new entry
-  if (ii == profile->profiler_entry_count) {
-    profile->profiler_entry_count++;
-    strcpy(profile->profiler_entries[ii].name, entry_name);
-    profile->profiler_entries[ii].time = 0;
-    profile->profiler_entries[ii].calls = 0;
+  ProfileThread *&thread = profile->threads[profiler_thread_index];
+  if (!thread) {
+    thread = new ProfileThread();
   }
+  return thread;
+}
 
-  // Update number of calls and time
-#ifdef __APPLE__
-  double elapsed = (profile->profiler_end - profile->profiler_start) * 1.0E-9;
-#else
-  double elapsed = (profile->profiler_end.tv_sec - profile->profiler_start.tv_sec) +
-                   (profile->profiler_end.tv_nsec - profile->profiler_start.tv_nsec) * 1.0E-9;
+// Innermost open region with a known node, -1 at the root
+static int profiler_enclosing_node(ProfileThread *thread) {
+  for (auto frame = thread->stack.rbegin(); frame != thread->stack.rend(); ++frame) {
+    if (frame->node >= 0) return frame->node;
+  }
+  return -1;
+}
+
+static int profiler_child_node(ProfileThread *thread, int parent, int region) {
+  uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(parent + 1)) << 32) | static_cast<uint32_t>(region);
+  auto found = thread->children.find(key);
+  if (found != thread->children.end()) {
+    return found->second;
+  }
+
+  // Only kernels are worth the cost of reading the hardware counters
+  bool counted = profiler_region_name(region).rfind("run_", 0) == 0;
+
+  int node = static_cast<int>(thread->nodes.size());
+  thread->nodes.push_back({region, parent, 0, 0.0, DBL_MAX, 0.0, counted, {}});
+  thread->children.emplace(key, node);
+  return node;
+}
+
+void profiler_start_region(Profile *profile, int region) {
+  ProfileThread *thread = profiler_thread(profile);
+  int node = profiler_child_node(thread, profiler_enclosing_node(thread), region);
+  PerfSample counters{};
+#ifdef ENABLE_PERF_COUNTERS
+  if (perf_counters_active && thread->nodes[node].counted) perf_counters_read(&counters);
+#endif
+  thread->stack.push_back({node, profiler_now(), counters});
+}
+
+void profiler_start_timer(Profile *profile) { profiler_thread(profile)->stack.push_back({-1, profiler_now(), {}}); }
+
+void profiler_end_region(Profile *profile, int region) {
+  double end = profiler_now();
+  ProfileThread *thread = profiler_thread(profile);
+  if (thread->stack.empty()) {
+    printf("Attempted to end profiling region %s which was never started\n", profiler_region_name(region).c_str());
+    exit(1);
+  }
+
+  ProfileFrame frame = thread->stack.back();
+  thread->stack.pop_back();
+
+  int node = frame.node;
+  if (node < 0 || thread->nodes[node].region != region) {
+    node = profiler_child_node(thread, profiler_enclosing_node(thread), region);
+  }
+
+  double elapsed = end - frame.start;
+  ProfileNode &entry = thread->nodes[node];
+  entry.calls++;
+  entry.time += elapsed;
+  entry.min_time = std::min(entry.min_time, elapsed);
+  entry.max_time = std::max(entry.max_time, elapsed);
+
+#ifdef ENABLE_PERF_COUNTERS
+  // Unnamed timers have no starting sample, so they are never counted
+  if (perf_counters_active && entry.counted && frame.node == node) {
+    PerfSample counters;
+    perf_counters_read(&counters);
+    profiler_add_counters(&entry.counters, counters, frame.counters);
+  }
 #endif
 
-  profile->profiler_entries[ii].time += elapsed;
-  profile->profiler_entries[ii].calls++;
+  if (trace_active) trace_record_region(region, frame.start, end);
 }
 
-// Print the profiling results to output
-void profiler_print_full_profile(Profile *profile) {
-  printf("\n -------------------------------------------------------------\n");
-  printf("\n Profiling Results:\n\n");
-  printf(" %-30s%8s%20s\n", "Kernel Name", "Calls", "Runtime (s)");
+void profiler_end_timer(Profile *profile, const char *entry_name) { profiler_end_region(profile, profiler_intern_region(entry_name)); }
 
-  double total_elapsed_time = 0.0;
-  for (int ii = 0; ii < profile->profiler_entry_count; ++ii) {
-    total_elapsed_time += profile->profiler_entries[ii].time;
-    printf(" %-30s%8d%20.03F\n", profile->profiler_entries[ii].name, profile->profiler_entries[ii].calls,
-           profile->profiler_entries[ii].time);
+// Merges the call trees of all threads by call path, parents always precede their children
+static std::vector<ProfileNode> profiler_merge_threads(Profile *profile) {
+  std::vector<ProfileNode> merged;
+  std::unordered_map<uint64_t, int> merged_children;
+
+  for (ProfileThread *thread : profile->threads) {
+    if (!thread) continue;
+
+    std::vector<int> to_merged(thread->nodes.size());
+    for (size_t nn = 0; nn < thread->nodes.size(); ++nn) {
+      const ProfileNode &node = thread->nodes[nn];
+      int parent = node.parent < 0 ? -1 : to_merged[node.parent];
+      uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(parent + 1)) << 32) | static_cast<uint32_t>(node.region);
+
+      auto found = merged_children.find(key);
+      if (found == merged_children.end()) {
+        found = merged_children.emplace(key, static_cast<int>(merged.size())).first;
+        merged.push_back({node.region, parent, 0, 0.0, DBL_MAX, 0.0, node.counted, {}});
+      }
+
+      ProfileNode &target = merged[found->second];
+      target.calls += node.calls;
+      target.time += node.time;
+      target.min_time = std::min(target.min_time, node.min_time);
+      target.max_time = std::max(target.max_time, node.max_time);
+      profiler_add_counters(&target.counters, node.counters, {});
+      to_merged[nn] = found->second;
+    }
   }
+  return merged;
+}
 
-  printf("\n Total elapsed time: %.03Fs, entries * are excluded.\n", total_elapsed_time);
-  printf("\n -------------------------------------------------------------\n\n");
+static ProfileEntry profiler_entry(const ProfileNode &node, int depth) {
+  return {profiler_region_name(node.region), depth, node.calls, node.time, node.calls ? node.min_time : 0.0, node.max_time, node.counters};
 }
 
-// Prints profile without extra details
-void profiler_print_simple_profile(Profile *profile) {
-  for (int ii = 0; ii < profile->profiler_entry_count; ++ii) {
-    printf("\033[1m\033[30m%s\033[0m: %.3lfs (%d calls)\n", profile->profiler_entries[ii].name, profile->profiler_entries[ii].time,
-           profile->profiler_entries[ii].calls);
+std::vector<ProfileEntry> profiler_tree_entries(Profile *profile) {
+  std::vector<ProfileNode> merged = profiler_merge_threads(profile);
+
+  std::vector<std::vector<int>> children(merged.size());
+  std::vector<int> roots;
+  for (size_t nn = 0; nn < merged.size(); ++nn) {
+    (merged[nn].parent < 0 ? roots : children[merged[nn].parent]).push_back(static_cast<int>(nn));
   }
+
+  // Depth-first, keeping siblings in order of first call
+  std::vector<ProfileEntry> entries;
+  std::vector<std::pair<int, int>> pending;
+  for (auto root = roots.rbegin(); root != roots.rend(); ++root) {
+    pending.emplace_back(*root, 0);
+  }
+  while (!pending.empty()) {
+    auto [node, depth] = pending.back();
+    pending.pop_back();
+    entries.push_back(profiler_entry(merged[node], depth));
+    for (auto child = children[node].rbegin(); child != children[node].rend(); ++child) {
+      pending.emplace_back(*child, depth + 1);
+    }
+  }
+  return entries;
 }
 
-// Gets an individual profile entry
-int profiler_get_profile_entry(Profile *profile, const char *entry_name) {
-  for (int ii = 0; ii < profile->profiler_entry_count; ++ii) {
-    if (tealeaf_strmatch(profile->profiler_entries[ii].name, entry_name)) {
-      return ii;
+std::vector<ProfileEntry> profiler_flat_entries(Profile *profile) {
+  std::vector<ProfileNode> merged = profiler_merge_threads(profile);
+
+  std::vector<ProfileNode> flat;
+  std::unordered_map<int, int> flat_index;
+  for (const ProfileNode &node : merged) {
+    auto found = flat_index.find(node.region);
+    if (found == flat_index.end()) {
+      found = flat_index.emplace(node.region, static_cast<int>(flat.size())).first;
+      flat.push_back({node.region, -1, 0, 0.0, DBL_MAX, 0.0, node.counted, {}});
+    }
+
+    ProfileNode &target = flat[found->second];
+    target.calls += node.calls;
+    target.time += node.time;
+    target.min_time = std::min(target.min_time, node.min_time);
+    target.max_time = std::max(target.max_time, node.max_time);
+    profiler_add_counters(&target.counters, node.counters, {});
+  }
+
+  std::vector<ProfileEntry> entries;
+  for (const ProfileNode &node : flat) {
+    entries.push_back(profiler_entry(node, 0));
+  }
+  return entries;
+}
+
+double profiler_get_time(Profile *profile, const char *entry_name) {
+  for (const ProfileEntry &entry : profiler_flat_entries(profile)) {
+    if (entry.name == entry_name) {
+      return entry.time;
     }
   }
 
   printf("Attempted to retrieve missing profile entry %s\n", entry_name);
   exit(1);
 }
+
+// Print the profiling results to output, nested regions are indented under their parent
+void profiler_print_full_profile(Profile *profile) {
+  printf("\n -------------------------------------------------------------\n");
+  printf("\n Profiling Results:\n\n");
+  printf(" %-36s%8s%14s%12s%12s%12s\n", "Kernel Name", "Calls", "Runtime (s)", "Min (ms)", "Avg (ms)", "Max (ms)");
+
+  double total_elapsed_time = 0.0;
+  for (const ProfileEntry &entry : profiler_tree_entries(profile)) {
+    if (!entry.depth) total_elapsed_time += entry.time;
+    int indent = 2 * entry.depth;
+    printf(" %*s%-*s%8ld%14.03F%12.03F%12.03F%12.03F\n", indent, "", 36 - indent, entry.name.c_str(), entry.calls, entry.time,
+           entry.min_time * 1.0E3, entry.calls ? entry.time / entry.calls * 1.0E3 : 0.0, entry.max_time * 1.0E3);
+  }
+
+  printf("\n Total elapsed time: %.03Fs, nested entries are included in their parents.\n", total_elapsed_time);
+  printf("\n -------------------------------------------------------------\n\n");
+}
+
+// Prints profile without extra details
+void profiler_print_simple_profile(Profile *profile) {
+  for (const ProfileEntry &entry : profiler_flat_entries(profile)) {
+    printf("\033[1m\033[30m%s\033[0m: %.3lfs (%ld calls)\n", entry.name.c_str(), entry.time, entry.calls);
+  }
+}
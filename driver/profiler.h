@@ -1,62 +1,78 @@
 #pragma once
 
-#ifdef __APPLE__
-  #include <mach/mach.h>
-  #include <mach/mach_time.h>
-#else
-  #include <ctime>
-#endif
+#include "perf_counters.h"
+#include <string>
+#include <vector>
 
 /*
  *		PROFILING TOOL
- *		Not thread safe.
+ *		Regions are interned once per call site and timed on a per-thread call tree, so
+ *		recording a region is an O(1) lookup and threads never contend.
  */
 
-#define PROFILER_MAX_NAME 128
-#define PROFILER_MAX_ENTRIES 2048
-
-#ifdef __cplusplus
-extern "C" {
-#endif
+#define PROFILER_MAX_THREADS 256
 
+// Statistics of a profiled region, merged over all threads
 struct ProfileEntry {
-  int calls;
+  std::string name;
+  int depth;
+  long calls;
   double time;
-  char name[PROFILER_MAX_NAME];
+  double min_time;
+  double max_time;
+  // Hardware event counts of run_* kernels, zero unless counters are enabled
+  PerfSample counters;
 };
 
-struct Profile {
-#ifdef __APPLE__
-  uint64_t profiler_start;
-  uint64_t profiler_end;
-#else
-  struct timespec profiler_start;
-  struct timespec profiler_end;
-#endif
+struct ProfileThread;
 
-  int profiler_entry_count;
-  ProfileEntry profiler_entries[PROFILER_MAX_ENTRIES];
+struct Profile {
+  ProfileThread *threads[PROFILER_MAX_THREADS];
 };
 
 Profile *profiler_initialise();
 void profiler_finalise(Profile **profile);
 
+// Returns the stable ID of a region name, registering it on first use
+int profiler_intern_region(const char *name);
+std::string profiler_region_name(int region);
+
+// Monotonic time in seconds
+double profiler_now();
+
+// Opens and closes a region nested inside the calling thread's currently open region
+void profiler_start_region(Profile *profile, int region);
+void profiler_end_region(Profile *profile, int region);
+
+// Unnamed start, the region is only resolved from the name given at the end
 void profiler_start_timer(Profile *profile);
 void profiler_end_timer(Profile *profile, const char *entry_name);
+
 void profiler_print_simple_profile(Profile *profile);
 void profiler_print_full_profile(Profile *profile);
-int profiler_get_profile_entry(Profile *profile, const char *entry_name);
 
-#ifdef __cplusplus
-}
-#endif
+// Entries in call-tree order, with their nesting depth
+std::vector<ProfileEntry> profiler_tree_entries(Profile *profile);
+// Entries summed over all call paths of each region, in order of first call
+std::vector<ProfileEntry> profiler_flat_entries(Profile *profile);
+// Total time spent in a region over all call paths
+double profiler_get_time(Profile *profile, const char *entry_name);
 
 // Allows compile-time optimised conditional profiling
 #ifdef ENABLE_PROFILING
 
-  #define START_PROFILING(profile) profiler_start_timer(profile)
+  // START and STOP must be called from the same function, and a STOP call site must always pass the same name
+  #define START_PROFILING(profile)                                            \
+    do {                                                                      \
+      static const int profiler_region_id = profiler_intern_region(__func__); \
+      profiler_start_region(profile, profiler_region_id);                     \
+    } while (false)
 
-  #define STOP_PROFILING(profile, name) profiler_end_timer(profile, name)
+  #define STOP_PROFILING(profile, name)                                   \
+    do {                                                                  \
+      static const int profiler_region_id = profiler_intern_region(name); \
+      profiler_end_region(profile, profiler_region_id);                   \
+    } while (false)
 
   #define PRINT_PROFILING_RESULTS(profile) profiler_print_full_profile(profile)
 
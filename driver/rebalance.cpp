@@ -0,0 +1,238 @@
+#include "rebalance.h"
+#include "application.h"
+#include "comms.h"
+#include "drivers.h"
+#include "kernel_interface.h"
+#include <algorithm>
+#include <vector>
+
+// The fields carried from one step to the next, all others are recomputed by the solve
+#define NUM_REBALANCE_FIELDS 4
+
+// A chunk's cells on the global mesh, without halos
+struct ChunkExtents {
+  int left;
+  int right;
+  int bottom;
+  int top;
+};
+
+static std::vector<ChunkExtents> all_chunk_extents(const Settings &settings) {
+  std::vector<ChunkExtents> extents(settings.num_ranks);
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    int coords[NUM_GRID_DIMENSIONS];
+    get_cart_coords(rr, coords);
+    ChunkExtents &e = extents[rr];
+    calc_chunk_extents(settings, coords[X_AXIS], coords[Y_AXIS], &e.left, &e.right, &e.bottom, &e.top);
+  }
+  return extents;
+}
+
+static ChunkExtents overlap(const ChunkExtents &a, const ChunkExtents &b) {
+  ChunkExtents o{std::max(a.left, b.left), std::min(a.right, b.right), std::max(a.bottom, b.bottom), std::min(a.top, b.top)};
+  if (o.right <= o.left || o.top <= o.bottom) return {0, 0, 0, 0};
+  return o;
+}
+
+static int num_cells(const ChunkExtents &o) { return (o.right - o.left) * (o.top - o.bottom); }
+
+// Splits the cells into widths proportional to the shares, none narrower than min_width, and returns the edges between them
+static std::vector<int> balance_edges(const std::vector<double> &shares, int cells, int min_width) {
+  int count = static_cast<int>(shares.size());
+  min_width = std::min(min_width, cells / count);
+  double total = 0.0;
+  for (double share : shares) {
+    total += share;
+  }
+
+  std::vector<double> ideal(count);
+  std::vector<int> widths(count);
+  int assigned = 0;
+  for (int ii = 0; ii < count; ++ii) {
+    ideal[ii] = cells * shares[ii] / total;
+    widths[ii] = std::max(min_width, static_cast<int>(ideal[ii]));
+    assigned += widths[ii];
+  }
+
+  // The largest remainders take the cells left over, the most oversized give back those the minimum width took
+  while (assigned < cells) {
+    int best = 0;
+    for (int ii = 1; ii < count; ++ii) {
+      if (ideal[ii] - widths[ii] > ideal[best] - widths[best]) best = ii;
+    }
+    ++widths[best];
+    ++assigned;
+  }
+  while (assigned > cells) {
+    int best = -1;
+    for (int ii = 0; ii < count; ++ii) {
+      if (widths[ii] > min_width && (best < 0 || widths[ii] - ideal[ii] > widths[best] - ideal[best])) best = ii;
+    }
+    --widths[best];
+    --assigned;
+  }
+
+  std::vector<int> edges(count + 1, 0);
+  for (int ii = 0; ii < count; ++ii) {
+    edges[ii + 1] = edges[ii] + widths[ii];
+  }
+  return edges;
+}
+
+// Reallocates the chunk at its new extents, reusing the mesh setup of initialisation
+static void resize_chunk(Chunk *chunks, Settings &settings, const ChunkExtents &extents) {
+  Chunk *chunk = &chunks[0];
+  double dt_init = chunk->dt_init;
+  double dt = chunk->dt;
+
+  kernel_finalise_driver(chunks, settings);
+  finalise_chunk(chunk);
+  initialise_chunk(chunk, settings, extents.right - extents.left, extents.top - extents.bottom);
+  chunk->left = extents.left;
+  chunk->right = extents.right;
+  chunk->bottom = extents.bottom;
+  chunk->top = extents.top;
+  chunk->dt_init = dt_init;
+  chunk->dt = dt;
+
+  kernel_initialise_driver(chunks, settings);
+  set_chunk_data_driver(chunks, settings);
+}
+
+void rebalance(Chunk *chunks, Settings &settings, double compute_time) {
+  // Failed ranks could not take part in moving the fields, and resizing the chunks initialises the kernels again
+  if (settings.num_ranks == 1 || settings.ft || !settings.model_reinitialisable) return;
+
+  // Compute times indexed by cartesian rank
+  std::vector<double> times(settings.num_ranks, 0.0);
+  times[settings.cart_rank] = compute_time;
+  sum_array_over_ranks(settings, times.data(), settings.num_ranks);
+  if (std::count_if(times.begin(), times.end(), [](double time) { return time <= 0.0; })) return;
+
+  // A column taking the same time as the others has a width inversely proportional to its time per unit width, likewise rows
+  std::vector<ChunkExtents> old_extents = all_chunk_extents(settings);
+  std::vector<double> column_cost(settings.grid_x_chunks, 0.0), row_cost(settings.grid_y_chunks, 0.0);
+  double max_time = 0.0, mean_time = 0.0;
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    int coords[NUM_GRID_DIMENSIONS];
+    get_cart_coords(rr, coords);
+    const ChunkExtents &e = old_extents[rr];
+    column_cost[coords[X_AXIS]] += times[rr] / (e.right - e.left);
+    row_cost[coords[Y_AXIS]] += times[rr] / (e.top - e.bottom);
+    max_time = std::max(max_time, times[rr]);
+    mean_time += times[rr] / settings.num_ranks;
+  }
+
+  std::vector<double> column_shares(settings.grid_x_chunks), row_shares(settings.grid_y_chunks);
+  std::transform(column_cost.begin(), column_cost.end(), column_shares.begin(), [](double cost) { return 1.0 / cost; });
+  std::transform(row_cost.begin(), row_cost.end(), row_shares.begin(), [](double cost) { return 1.0 / cost; });
+  std::vector<int> x_edges = balance_edges(column_shares, settings.grid_x_cells, settings.halo_depth);
+  std::vector<int> y_edges = balance_edges(row_shares, settings.grid_y_cells, settings.halo_depth);
+
+  // Each chunk is predicted to keep its measured time per cell
+  double predicted_max = 0.0;
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    int coords[NUM_GRID_DIMENSIONS];
+    get_cart_coords(rr, coords);
+    const ChunkExtents &e = old_extents[rr];
+    double cells = static_cast<double>(x_edges[coords[X_AXIS] + 1] - x_edges[coords[X_AXIS]]) *
+                   (y_edges[coords[Y_AXIS] + 1] - y_edges[coords[Y_AXIS]]);
+    predicted_max = std::max(predicted_max, times[rr] / num_cells(e) * cells);
+  }
+
+  print_and_log(settings, "\n Rebalancing after %d steps:\n", settings.rebalance_steps);
+  print_and_log(settings, " - Compute time:  max %.6e s, mean %.6e s\n", max_time, mean_time);
+  print_and_log(settings, " - Imbalance:     %.3f measured, %.3f predicted\n", max_time / mean_time, predicted_max / mean_time);
+  if (max_time / mean_time < settings.rebalance_threshold || predicted_max >= max_time) {
+    print_and_log(settings, " - Kept the current decomposition\n");
+    return;
+  }
+
+  settings.chunk_x_edges = x_edges;
+  settings.chunk_y_edges = y_edges;
+  std::vector<ChunkExtents> new_extents = all_chunk_extents(settings);
+  const ChunkExtents &own_old = old_extents[settings.cart_rank];
+  const ChunkExtents &own_new = new_extents[settings.cart_rank];
+
+  // Host copies of the fields on the old chunk, halos included
+  Chunk *chunk = &chunks[0];
+  FieldBufferType fields[NUM_REBALANCE_FIELDS] = {chunk->density, chunk->energy0, chunk->energy, chunk->u};
+  int old_x = chunk->x;
+  int old_len = chunk->x * chunk->y;
+  std::vector<double> old_fields(static_cast<size_t>(old_len) * NUM_REBALANCE_FIELDS);
+  for (int ff = 0; ff < NUM_REBALANCE_FIELDS; ++ff) {
+    run_field_to_host(chunk, settings, fields[ff], &old_fields[static_cast<size_t>(ff) * old_len]);
+  }
+
+  // Every rank receives the cells of its new chunk from the old chunks overlapping it, field by field and row by row
+  std::vector<int> send_counts(settings.num_ranks), send_displs(settings.num_ranks);
+  std::vector<int> recv_counts(settings.num_ranks), recv_displs(settings.num_ranks);
+  int send_total = 0, recv_total = 0;
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    send_counts[rr] = num_cells(overlap(own_old, new_extents[rr])) * NUM_REBALANCE_FIELDS;
+    recv_counts[rr] = num_cells(overlap(old_extents[rr], own_new)) * NUM_REBALANCE_FIELDS;
+    send_displs[rr] = send_total;
+    recv_displs[rr] = recv_total;
+    send_total += send_counts[rr];
+    recv_total += recv_counts[rr];
+  }
+
+  std::vector<double> send_buffer(send_total), recv_buffer(recv_total);
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    ChunkExtents o = overlap(own_old, new_extents[rr]);
+    double *packed = &send_buffer[send_displs[rr]];
+    for (int ff = 0; ff < NUM_REBALANCE_FIELDS; ++ff) {
+      const double *field = &old_fields[static_cast<size_t>(ff) * old_len];
+      for (int jj = o.bottom; jj < o.top; ++jj) {
+        for (int kk = o.left; kk < o.right; ++kk) {
+          *packed++ = field[(jj - own_old.bottom + settings.halo_depth) * old_x + (kk - own_old.left + settings.halo_depth)];
+        }
+      }
+    }
+  }
+  exchange_over_ranks(settings, send_buffer.data(), send_counts.data(), send_displs.data(), recv_buffer.data(), recv_counts.data(),
+                      recv_displs.data());
+  old_fields.clear();
+
+  resize_chunk(chunks, settings, own_new);
+
+  // Halos are left zeroed for the halo update to fill
+  int new_x = chunk->x;
+  int new_len = chunk->x * chunk->y;
+  std::vector<double> new_fields(static_cast<size_t>(new_len) * NUM_REBALANCE_FIELDS, 0.0);
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    ChunkExtents o = overlap(old_extents[rr], own_new);
+    const double *packed = &recv_buffer[recv_displs[rr]];
+    for (int ff = 0; ff < NUM_REBALANCE_FIELDS; ++ff) {
+      double *field = &new_fields[static_cast<size_t>(ff) * new_len];
+      for (int jj = o.bottom; jj < o.top; ++jj) {
+        for (int kk = o.left; kk < o.right; ++kk) {
+          field[(jj - own_new.bottom + settings.halo_depth) * new_x + (kk - own_new.left + settings.halo_depth)] = *packed++;
+        }
+      }
+    }
+  }
+  FieldBufferType new_buffers[NUM_REBALANCE_FIELDS] = {chunk->density, chunk->energy0, chunk->energy, chunk->u};
+  for (int ff = 0; ff < NUM_REBALANCE_FIELDS; ++ff) {
+    run_field_from_host(chunk, settings, &new_fields[static_cast<size_t>(ff) * new_len], new_buffers[ff]);
+  }
+
+  reset_fields_to_exchange(settings);
+  settings.fields_to_exchange[FIELD_DENSITY] = true;
+  settings.fields_to_exchange[FIELD_ENERGY0] = true;
+  settings.fields_to_exchange[FIELD_ENERGY1] = true;
+  // Halo buffers in windows are sized by the chunk, so they are reallocated before the halo update uses them
+  initialise_shared_halos(settings, chunk);
+  initialise_rma_halos(settings, chunk);
+  halo_update_driver(chunks, settings, 2);
+
+  print_and_log(settings, " - Column widths:");
+  for (int xx = 0; xx < settings.grid_x_chunks; ++xx) {
+    print_and_log(settings, " %d", x_edges[xx + 1] - x_edges[xx]);
+  }
+  print_and_log(settings, "\n - Row heights:  ");
+  for (int yy = 0; yy < settings.grid_y_chunks; ++yy) {
+    print_and_log(settings, " %d", y_edges[yy + 1] - y_edges[yy]);
+  }
+  print_and_log(settings, "\n");
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "chunk.h"
+#include "settings.h"
+
+/*
+ *		LOAD BALANCING
+ *		Resizes the columns and rows of the grid of chunks after the first steps, so that every rank
+ *		would have taken the same compute time over them, and moves the field data to the new owners.
+ *		Columns and rows stay aligned, keeping every chunk a rectangle with at most four neighbours.
+ */
+
+#define DEF_REBALANCE_STEPS 0
+#define DEF_REBALANCE_THRESHOLD 1.05
+
+// Rebalances from the compute time this rank spent in the steps so far, collective over all ranks
+void rebalance(Chunk *chunks, Settings &settings, double compute_time);
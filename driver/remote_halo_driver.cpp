@@ -3,126 +3,245 @@
 #include "drivers.h"
 #include "kernel_interface.h"
 
+#include <algorithm>
 #include <iostream>
+#include <type_traits>
+
+static FieldBufferType exchanged_field(Chunk *chunk, int ii) {
+  switch (ii) {
+    case FIELD_DENSITY: return chunk->density;
+    case FIELD_ENERGY0: return chunk->energy0;
+    case FIELD_ENERGY1: return chunk->energy;
+    case FIELD_U: return chunk->u;
+    case FIELD_P: return chunk->p;
+    case FIELD_SD: return chunk->sd;
+    default: die(__LINE__, __FILE__, "Incorrect field provided: %d.\n", ii + 1);
+  }
+  return FieldBufferType{};
+}
 
+// Packs or unpacks the exchanged fields on every face with a buffer in one kernel
+static void pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType buffers[NUM_FACES]) {
+  if (std::none_of(buffers, buffers + NUM_FACES, [](FieldBufferType buffer) { return buffer != FieldBufferType{}; })) return;
 
-// Attempts to pack buffers
-int invoke_pack_or_unpack(Chunk *chunk, Settings &settings, int face, int depth, int offset, bool pack, FieldBufferType buffer) {
-  int buffer_len = 0;
-
+  FieldBufferType fields[NUM_FIELDS];
   for (int ii = 0; ii < NUM_FIELDS; ++ii) {
-    if (!settings.fields_to_exchange[ii]) {
-      continue;
-    }
-
-    FieldBufferType field;
-    switch (ii) {
-      case FIELD_DENSITY: field = chunk->density; break;
-      case FIELD_ENERGY0: field = chunk->energy0; break;
-      case FIELD_ENERGY1: field = chunk->energy; break;
-      case FIELD_U: field = chunk->u; break;
-      case FIELD_P: field = chunk->p; break;
-      case FIELD_SD: field = chunk->sd; break;
-      default: die(__LINE__, __FILE__, "Incorrect field provided: %d.\n", ii + 1);
-    }
-
-    //    double *offset_buffer = buffer + buffer_len;
-    //    buffer_len += depth * offset;
-    //
-    //    if (settings.kernel_language == Kernel_Language::C) {
-    //      run_pack_or_unpack(chunk, settings, depth, face, pack, field, offset_buffer);
-    //    } else if (settings.kernel_language == Kernel_Language::FORTRAN) {
-    //    }
-
-    if (settings.kernel_language == Kernel_Language::C) {
-      run_pack_or_unpack(chunk, settings, depth, face, pack, field, buffer, buffer_len);
-    } else if (settings.kernel_language == Kernel_Language::FORTRAN) {
-    }
-    buffer_len += depth * offset;
+    fields[ii] = settings.fields_to_exchange[ii] ? exchanged_field(chunk, ii) : FieldBufferType{};
+  }
+  if (settings.kernel_language == Kernel_Language::C) {
+    run_pack_or_unpack_faces(chunk, settings, depth, pack, fields, buffers);
+  } else if (settings.kernel_language == Kernel_Language::FORTRAN) {
   }
+}
 
-  return buffer_len;
+// Shared-memory segments and derived datatypes address host memory, converted only where field buffers are host pointers
+template <typename Target, typename Source> static Target host_buffer(Source buffer) {
+  if constexpr (std::is_same<Target, Source>::value) {
+    return buffer;
+  } else {
+    return nullptr;
+  }
 }
 
-// Invokes the kernels that perform remote halo exchanges
-void remote_halo_driver(Chunk *chunks, Settings &settings, int depth) {
-#ifndef NO_MPI
-  int neighbour_ranks[NUM_NEIGHBOURS], neighbour_offset = 1;
-  get_cart_neighbour_ranks(neighbour_offset, neighbour_ranks);
+// Derived datatypes address the field arrays in host memory, so only models whose field buffers are host pointers use them, and
+// fault tolerance keeps the packed buffers it recovers failed messages into
+static bool use_datatype_halos(Settings &settings) {
+  return settings.datatype_halos && !settings.ft && settings.model_kind == ModelKind::Host &&
+         std::is_same<FieldBufferType, double *>::value;
+}
 
-  // Pack lr buffers and send messages
-  if (neighbour_ranks[LEFT] != MPI_PROC_NULL) {
-    int buffer_len = invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_LEFT, depth, chunks[0].y, true, chunks[0].left_send);
-    run_send_recv_halo(&chunks[0], settings,                                                 //
-                       chunks[0].left_send, chunks[0].left_recv,                             //
-                       chunks[0].staging_left_send, chunks[0].staging_left_recv, buffer_len, //
-                       neighbour_ranks[LEFT], 0, 1);
+// Exchanges a face with a remote neighbour without packing, the message reading and writing the fields in place
+static void send_recv_fields(Chunk *chunk, Settings &settings, int neighbour_rank, int face, int depth, int offset, int send_tag,
+                             int recv_tag) {
+  double *fields[NUM_FIELDS];
+  int buffer_len = 0;
+  for (int ii = 0; ii < NUM_FIELDS; ++ii) {
+    fields[ii] = settings.fields_to_exchange[ii] ? host_buffer<double *, FieldBufferType>(exchanged_field(chunk, ii)) : nullptr;
+    if (fields[ii]) buffer_len += depth * offset;
   }
-  if (neighbour_ranks[RIGHT] != MPI_PROC_NULL) {
-    int buffer_len = invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_RIGHT, depth, chunks[0].y, true, chunks[0].right_send);
-    run_send_recv_halo(&chunks[0], settings,                                                   //
-                       chunks[0].right_send, chunks[0].right_recv,                             //
-                       chunks[0].staging_right_send, chunks[0].staging_right_recv, buffer_len, //
-                       neighbour_ranks[RIGHT], 1, 0);
+  send_recv_halo_fields(settings, fields, chunk->x, chunk->y, face, depth, buffer_len, neighbour_rank, send_tag, recv_tag);
+}
+
+// The face buffers and message tags of a neighbour
+struct NeighbourBuffers {
+  int face;
+  FieldBufferType send;
+  FieldBufferType recv;
+  StagingBufferType staging_send;
+  StagingBufferType staging_recv;
+  int send_tag;
+  int recv_tag;
+};
+
+static NeighbourBuffers neighbour_buffers(Chunk *chunk, int neighbour) {
+  switch (neighbour) {
+    case LEFT: return {CHUNK_LEFT, chunk->left_send, chunk->left_recv, chunk->staging_left_send, chunk->staging_left_recv, 0, 1};
+    case RIGHT: return {CHUNK_RIGHT, chunk->right_send, chunk->right_recv, chunk->staging_right_send, chunk->staging_right_recv, 1, 0};
+    case DOWN:
+      return {CHUNK_BOTTOM, chunk->bottom_send, chunk->bottom_recv, chunk->staging_bottom_send, chunk->staging_bottom_recv, 0, 1};
+    case UP: return {CHUNK_TOP, chunk->top_send, chunk->top_recv, chunk->staging_top_send, chunk->staging_top_recv, 1, 0};
+    default: die(__LINE__, __FILE__, "Incorrect neighbour provided: %d.\n", neighbour);
   }
+  return NeighbourBuffers{};
+}
 
+// Exchanges the faces shared with the two neighbours along one axis, offset cells long. One kernel packs both faces, into the
+// shared segment of a neighbour on this node or the send buffer of a remote one, and one kernel unpacks them
+static void exchange_axis(Chunk *chunk, Settings &settings, const int neighbour_ranks[NUM_NEIGHBOURS], int first_neighbour, int depth,
+                          int offset) {
   int buffer_len = 0;
   for (int ii = 0; ii < NUM_FIELDS; ++ii) {
     if (!settings.fields_to_exchange[ii]) continue;
-    buffer_len += depth * chunks[0].y;
+    buffer_len += depth * offset;
   }
-  // actually, forked version of TeaLeaf does not allow more than 1 chunk per rank !
-  if (neighbour_ranks[LEFT] != MPI_PROC_NULL) {
-    run_restore_recv_halo(&chunks[0], settings, chunks[0].left_recv, chunks[0].staging_left_recv, buffer_len);
+
+  // Remote neighbours exchange either in place through derived datatypes or through packed buffers
+  bool direct = use_datatype_halos(settings);
+  bool shared[NUM_NEIGHBOURS] = {}, packed[NUM_NEIGHBOURS] = {};
+  NeighbourBuffers buffers[NUM_NEIGHBOURS];
+  FieldBufferType send[NUM_FACES] = {}, recv[NUM_FACES] = {};
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (neighbour_ranks[nn] == MPI_PROC_NULL) continue;
+    buffers[nn] = neighbour_buffers(chunk, nn);
+    double *shared_buffer = shared_halo_send_buffer(settings, nn);
+    shared[nn] = shared_buffer != nullptr;
+    packed[nn] = !shared[nn] && !direct;
+    if (shared[nn]) send[buffers[nn].face] = host_buffer<FieldBufferType, double *>(shared_buffer);
+    if (packed[nn]) send[buffers[nn].face] = buffers[nn].send;
   }
-  if (neighbour_ranks[RIGHT] != MPI_PROC_NULL) {
-    run_restore_recv_halo(&chunks[0], settings, chunks[0].right_recv, chunks[0].staging_right_recv, buffer_len);
+
+  pack_or_unpack_faces(chunk, settings, depth, true, send);
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (shared[nn]) shared_halo_post(nn);
   }
 
-  // Unpack lr buffers
-  // actually, forked version of TeaLeaf does not allow more than 1 chunk per rank !
-  if (neighbour_ranks[LEFT] != MPI_PROC_NULL) {
-    invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_LEFT, depth, chunks[0].y, false, chunks[0].left_recv);
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (neighbour_ranks[nn] == MPI_PROC_NULL || shared[nn] || packed[nn]) continue;
+    send_recv_fields(chunk, settings, neighbour_ranks[nn], buffers[nn].face, depth, offset, buffers[nn].send_tag, buffers[nn].recv_tag);
   }
-  if (neighbour_ranks[RIGHT] != MPI_PROC_NULL) {
-    invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_RIGHT, depth, chunks[0].y, false, chunks[0].right_recv);
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (!packed[nn]) continue;
+    run_send_recv_halo(chunk, settings, buffers[nn].send, buffers[nn].recv, buffers[nn].staging_send, buffers[nn].staging_recv, buffer_len,
+                       neighbour_ranks[nn], buffers[nn].send_tag, buffers[nn].recv_tag);
+  }
+  // actually, forked version of TeaLeaf does not allow more than 1 chunk per rank !
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (!packed[nn]) continue;
+    run_restore_recv_halo(chunk, settings, buffers[nn].recv, buffers[nn].staging_recv, buffer_len);
+    recv[buffers[nn].face] = buffers[nn].recv;
   }
 
-  // Pack tb buffers and send messages
-  if (neighbour_ranks[DOWN] != MPI_PROC_NULL) {
-    int buffer_len = invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_BOTTOM, depth, chunks[0].x, true, chunks[0].bottom_send);
-    run_send_recv_halo(&chunks[0], settings,                                                     //
-                       chunks[0].bottom_send, chunks[0].bottom_recv,                             //
-                       chunks[0].staging_bottom_send, chunks[0].staging_bottom_recv, buffer_len, //
-                       neighbour_ranks[DOWN], 0, 1);
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (shared[nn]) recv[buffers[nn].face] = host_buffer<FieldBufferType, double *>(shared_halo_recv_buffer(settings, nn));
   }
-  if (neighbour_ranks[UP] != MPI_PROC_NULL) {
-    int buffer_len = invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_TOP, depth, chunks[0].x, true, chunks[0].top_send);
-    run_send_recv_halo(&chunks[0], settings,                                               //
-                       chunks[0].top_send, chunks[0].top_recv,                             //
-                       chunks[0].staging_top_send, chunks[0].staging_top_recv, buffer_len, //
-                       neighbour_ranks[UP], 1, 0);
+  pack_or_unpack_faces(chunk, settings, depth, false, recv);
+  for (int nn = first_neighbour; nn < first_neighbour + 2; ++nn) {
+    if (shared[nn]) shared_halo_release(nn);
   }
+}
+
+// Remote neighbours exchange all four faces at once, through one neighbourhood collective or one-sided puts, packed into host
+// buffers and fault tolerance keeping point-to-point messages
+static bool use_four_face_halos(Settings &settings) {
+  return (settings.halo_exchange == HaloExchange::NEIGHBOURHOOD || settings.halo_exchange == HaloExchange::RMA) && !settings.ft &&
+         settings.model_kind == ModelKind::Host && std::is_same<FieldBufferType, double *>::value;
+}
+
+// A four-face exchange posted by remote_halo_start, unpacked by remote_halo_finish
+struct PendingHalos {
+  bool posted;
+  HaloExchange exchange;
+  int depth;
+  bool shared[NUM_NEIGHBOURS];
+  double *recv[NUM_NEIGHBOURS];
+};
+
+#ifdef MPI_THREADS
+thread_local PendingHalos pending_halos{};
+#else
+PendingHalos pending_halos{};
+#endif
 
-  buffer_len = 0;
+// Packs all four faces in one kernel and posts those of remote neighbours as one collective or as puts into their windows
+static void start_four_faces(Chunk *chunk, Settings &settings, const int neighbour_ranks[NUM_NEIGHBOURS], int depth) {
+  int num_fields = 0;
   for (int ii = 0; ii < NUM_FIELDS; ++ii) {
-    if (!settings.fields_to_exchange[ii]) continue;
-    buffer_len += depth * chunks[0].x;
+    num_fields += settings.fields_to_exchange[ii];
   }
-  if (neighbour_ranks[DOWN] != MPI_PROC_NULL) {
-    run_restore_recv_halo(&chunks[0], settings, chunks[0].bottom_recv, chunks[0].staging_bottom_recv, buffer_len);
+
+  int counts[NUM_NEIGHBOURS];
+  FieldBufferType send[NUM_FACES] = {};
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    counts[nn] = 0;
+    pending_halos.shared[nn] = false;
+    if (neighbour_ranks[nn] == MPI_PROC_NULL) continue;
+    double *shared_buffer = shared_halo_send_buffer(settings, nn);
+    pending_halos.shared[nn] = shared_buffer != nullptr;
+    if (shared_buffer) send[neighbour_buffers(chunk, nn).face] = host_buffer<FieldBufferType, double *>(shared_buffer);
+    else
+      counts[nn] = depth * num_fields * (nn == LEFT || nn == RIGHT ? chunk->y : chunk->x);
   }
-  if (neighbour_ranks[UP] != MPI_PROC_NULL) {
-    run_restore_recv_halo(&chunks[0], settings, chunks[0].top_recv, chunks[0].staging_top_recv, buffer_len);
+
+  bool rma = settings.halo_exchange == HaloExchange::RMA;
+  double *send_buffers[NUM_NEIGHBOURS];
+  if (rma) rma_halo_buffers(counts, send_buffers, pending_halos.recv);
+  else
+    neighbour_halo_buffers(counts, send_buffers, pending_halos.recv);
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (send_buffers[nn]) send[neighbour_buffers(chunk, nn).face] = host_buffer<FieldBufferType, double *>(send_buffers[nn]);
   }
 
-  // Unpack tb buffers
-  if (neighbour_ranks[DOWN] != MPI_PROC_NULL) {
-    invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_BOTTOM, depth, chunks[0].x, false, chunks[0].bottom_recv);
+  pack_or_unpack_faces(chunk, settings, depth, true, send);
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (pending_halos.shared[nn]) shared_halo_post(nn);
   }
-  if (neighbour_ranks[UP] != MPI_PROC_NULL) {
-    invoke_pack_or_unpack(&(chunks[0]), settings, CHUNK_TOP, depth, chunks[0].x, false, chunks[0].top_recv);
+  if (rma) rma_halo_start(settings);
+  else
+    neighbour_halo_start(settings);
+  pending_halos.posted = true;
+  pending_halos.exchange = settings.halo_exchange;
+  pending_halos.depth = depth;
+}
+
+// Posts the remote halo exchange, which only a neighbourhood collective or one-sided puts leave in flight for remote_halo_finish
+void remote_halo_start(Chunk *chunks, Settings &settings, int depth) {
+#ifndef NO_MPI
+  int neighbour_ranks[NUM_NEIGHBOURS], neighbour_offset = 1;
+  get_cart_neighbour_ranks(neighbour_offset, neighbour_ranks);
+
+  // All four faces at once, as the top and bottom faces of host models leave out the halo columns
+  if (use_four_face_halos(settings)) {
+    start_four_faces(&(chunks[0]), settings, neighbour_ranks, depth);
+    return;
   }
 
+  // Left and right first, as top and bottom faces of some models span the halo columns just received
+  exchange_axis(&(chunks[0]), settings, neighbour_ranks, LEFT, depth, chunks[0].y);
+  exchange_axis(&(chunks[0]), settings, neighbour_ranks, DOWN, depth, chunks[0].x);
 #endif
 }
+
+// Waits for and unpacks a four-face exchange left in flight by remote_halo_start
+void remote_halo_finish(Chunk *chunks, Settings &settings) {
+  if (!pending_halos.posted) return;
+  pending_halos.posted = false;
+  if (pending_halos.exchange == HaloExchange::RMA) rma_halo_wait(settings);
+  else
+    neighbour_halo_wait(settings);
+
+  FieldBufferType recv[NUM_FACES] = {};
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    double *buffer = pending_halos.shared[nn] ? shared_halo_recv_buffer(settings, nn) : pending_halos.recv[nn];
+    if (buffer) recv[neighbour_buffers(&(chunks[0]), nn).face] = host_buffer<FieldBufferType, double *>(buffer);
+  }
+  pack_or_unpack_faces(&(chunks[0]), settings, pending_halos.depth, false, recv);
+  for (int nn = 0; nn < NUM_NEIGHBOURS; ++nn) {
+    if (pending_halos.shared[nn]) shared_halo_release(nn);
+  }
+}
+
+// Invokes the kernels that perform remote halo exchanges
+void remote_halo_driver(Chunk *chunks, Settings &settings, int depth) {
+  remote_halo_start(chunks, settings, depth);
+  remote_halo_finish(chunks, settings);
+}
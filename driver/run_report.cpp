@@ -0,0 +1,204 @@
+#include "run_report.h"
+#include "application.h"
+#include "comms.h"
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct RunReportStep {
+  int step;
+  int iterations;
+  double dt;
+  double time;
+  double error;
+  double wallclock;
+};
+
+struct RunReportSummary {
+  bool recorded;
+  double volume;
+  double mass;
+  double internal_energy;
+  double temperature;
+};
+
+struct RunReportCheck {
+  bool recorded;
+  double expected;
+  double difference;
+  bool passed;
+};
+
+struct RunReportMapping {
+  int nodes;
+  std::vector<int> cart_nodes;
+  long identity_bytes;
+  long mapped_bytes;
+  bool mapped;
+};
+
+static std::vector<RunReportStep> run_report_steps;
+static RunReportMapping run_report_rank_mapping{};
+static RunReportSummary run_report_final_summary{};
+static RunReportCheck run_report_final_check{};
+
+void run_report_mapping(int nodes, const std::vector<int> &cart_nodes, long identity_bytes, long mapped_bytes, bool mapped) {
+  run_report_rank_mapping = {nodes, cart_nodes, identity_bytes, mapped_bytes, mapped};
+}
+
+void run_report_step(Settings &settings, int step, double dt, double error, double wallclock) {
+  run_report_steps.push_back({step, settings.solve_iterations, dt, settings.sim_time, error, wallclock});
+}
+
+void run_report_summary(double volume, double mass, double internal_energy, double temperature) {
+  run_report_final_summary = {true, volume, mass, internal_energy, temperature};
+}
+
+void run_report_check(double expected, double difference, bool passed) { run_report_final_check = {true, expected, difference, passed}; }
+
+RunReportTotals run_report_totals() {
+  long iterations = 0;
+  for (const RunReportStep &step : run_report_steps) {
+    iterations += step.iterations;
+  }
+  return {static_cast<int>(run_report_steps.size()), iterations, run_report_final_summary.temperature, run_report_final_check.recorded,
+          run_report_final_check.passed};
+}
+
+void run_report_reset() {
+  run_report_steps.clear();
+  run_report_final_summary = {};
+  run_report_final_check = {};
+}
+
+// Writes a quoted JSON string, escaping the characters that may appear in paths and names
+static void run_report_string(FILE *fp, const char *value) {
+  std::fputc('"', fp);
+  for (const char *cc = value; *cc; ++cc) {
+    if (*cc == '"' || *cc == '\\') std::fputc('\\', fp);
+    std::fputc(*cc, fp);
+  }
+  std::fputc('"', fp);
+}
+
+// Formats a result of the solve as a JSON number, or null once it has diverged to a NaN or infinity that JSON cannot hold
+static std::string run_report_number(double value) {
+  if (!std::isfinite(value)) return "null";
+  char formatted[32];
+  std::snprintf(formatted, sizeof(formatted), "%.15e", value);
+  return formatted;
+}
+
+static const char *halo_exchange_name(HaloExchange halo_exchange) {
+  switch (halo_exchange) {
+    case HaloExchange::BLOCKING: return "blocking";
+    case HaloExchange::NONBLOCKING: return "nonblocking";
+    case HaloExchange::NEIGHBOURHOOD: return "neighbourhood";
+    case HaloExchange::RMA: return "rma";
+  }
+  return "unknown";
+}
+
+static void run_report_config(FILE *fp, Settings &settings) {
+  const char *solver = settings.solver_name;
+  std::fprintf(fp, "  \"config\": {\n    \"deck\": ");
+  run_report_string(fp, settings.tea_in_filename);
+  std::fprintf(fp, ",\n    \"model\": ");
+  run_report_string(fp, settings.model_name.c_str());
+  std::fprintf(fp, ",\n    \"solver\": ");
+  run_report_string(fp, solver ? solver : "");
+  std::fprintf(fp, ",\n    \"x_cells\": %d,\n    \"y_cells\": %d,\n", settings.grid_x_cells, settings.grid_y_cells);
+  std::fprintf(fp, "    \"x_min\": %.15e,\n    \"y_min\": %.15e,\n", settings.grid_x_min, settings.grid_y_min);
+  std::fprintf(fp, "    \"x_max\": %.15e,\n    \"y_max\": %.15e,\n", settings.grid_x_max, settings.grid_y_max);
+  std::fprintf(fp, "    \"dt_init\": %.15e,\n    \"end_step\": %d,\n    \"end_time\": %.15e,\n", settings.dt_init, settings.end_step,
+               settings.end_time);
+  std::fprintf(fp, "    \"adaptive_timestep\": %s,\n", settings.adaptive_timestep ? "true" : "false");
+  std::fprintf(fp, "    \"max_iters\": %d,\n    \"eps\": %.15e,\n", settings.max_iters, settings.eps);
+  std::fprintf(fp, "    \"coefficient\": %d,\n    \"preconditioner\": %s,\n", settings.coefficient,
+               settings.preconditioner ? "true" : "false");
+  std::fprintf(fp, "    \"halo_depth\": %d,\n    \"halo_exchange\": \"%s\",\n", settings.halo_depth,
+               halo_exchange_name(settings.halo_exchange));
+  std::fprintf(fp, "    \"shared_halos\": %s,\n", settings.shared_halos ? "true" : "false");
+  std::fprintf(fp, "    \"datatype_halos\": %s,\n", settings.datatype_halos ? "true" : "false");
+  std::fprintf(fp, "    \"staging_buffer\": %s\n  },\n", settings.staging_buffer ? "true" : "false");
+}
+
+// The extents of every rank follow from its cartesian coordinates, so the master can list them all
+static void run_report_decomposition(FILE *fp, Settings &settings) {
+  std::fprintf(fp, "  \"decomposition\": {\n    \"ranks\": %d,\n", settings.num_ranks);
+  std::fprintf(fp, "    \"x_chunks\": %d,\n    \"y_chunks\": %d,\n", settings.grid_x_chunks, settings.grid_y_chunks);
+  const RunReportMapping &mapping = run_report_rank_mapping;
+  std::fprintf(fp, "    \"nodes\": %d,\n    \"rank_mapping\": \"%s\",\n", mapping.nodes, mapping.mapped ? "node" : "identity");
+  std::fprintf(fp, "    \"internode_halo_bytes\": {\"identity\": %ld, \"mapped\": %ld},\n    \"chunks\": [", mapping.identity_bytes,
+               mapping.mapped_bytes);
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    int coords[NUM_GRID_DIMENSIONS];
+    get_cart_coords(rr, coords);
+    int left, right, bottom, top;
+    calc_chunk_extents(settings, coords[X_AXIS], coords[Y_AXIS], &left, &right, &bottom, &top);
+    int node = rr < static_cast<int>(mapping.cart_nodes.size()) ? mapping.cart_nodes[rr] : 0;
+    std::fprintf(fp, "%s\n      {\"rank\": %d, \"node\": %d, \"x\": %d, \"y\": %d, ", rr ? "," : "", rr, node, coords[X_AXIS],
+                 coords[Y_AXIS]);
+    std::fprintf(fp, "\"left\": %d, \"right\": %d, \"bottom\": %d, \"top\": %d}", left, right, bottom, top);
+  }
+  std::fprintf(fp, "\n    ]\n  },\n");
+}
+
+static void run_report_timesteps(FILE *fp) {
+  std::fprintf(fp, "  \"steps\": [");
+  for (size_t ss = 0; ss < run_report_steps.size(); ++ss) {
+    const RunReportStep &step = run_report_steps[ss];
+    std::fprintf(fp, "%s\n    {\"step\": %d, \"iterations\": %d, \"dt\": %.15e, \"time\": %.15e, \"error\": %s, \"wallclock\": %.9e}",
+                 ss ? "," : "", step.step, step.iterations, step.dt, step.time, run_report_number(step.error).c_str(), step.wallclock);
+  }
+  std::fprintf(fp, "\n  ],\n");
+}
+
+static void run_report_kernels(FILE *fp, Settings &settings) {
+  std::vector<ProfileEntry> entries = profiler_flat_entries(settings.kernel_profile);
+  std::fprintf(fp, "  \"kernels\": [");
+  for (size_t ee = 0; ee < entries.size(); ++ee) {
+    const ProfileEntry &entry = entries[ee];
+    std::fprintf(fp, "%s\n    {\"name\": ", ee ? "," : "");
+    run_report_string(fp, entry.name.c_str());
+    std::fprintf(fp, ", \"calls\": %ld, \"time\": %.9e, \"min\": %.9e, \"max\": %.9e}", entry.calls, entry.time, entry.min_time,
+                 entry.max_time);
+  }
+  std::fprintf(fp, "%s],\n", entries.empty() ? "" : "\n  ");
+}
+
+static void run_report_result(FILE *fp, Settings &settings, bool valid) {
+  std::fprintf(fp, "  \"result\": {\n    \"valid\": %s,\n", valid ? "true" : "false");
+  std::fprintf(fp, "    \"steps\": %d,\n    \"time\": %.15e", settings.sim_steps, settings.sim_time);
+  const RunReportSummary &summary = run_report_final_summary;
+  if (summary.recorded) {
+    std::fprintf(fp, ",\n    \"volume\": %s,\n    \"mass\": %s,\n", run_report_number(summary.volume).c_str(),
+                 run_report_number(summary.mass).c_str());
+    std::fprintf(fp, "    \"internal_energy\": %s,\n    \"temperature\": %s", run_report_number(summary.internal_energy).c_str(),
+                 run_report_number(summary.temperature).c_str());
+  }
+  const RunReportCheck &check = run_report_final_check;
+  if (check.recorded) {
+    std::fprintf(fp, ",\n    \"expected_temperature\": %.15e,\n    \"difference_percent\": %s,\n    \"passed\": %s", check.expected,
+                 run_report_number(check.difference).c_str(), check.passed ? "true" : "false");
+  }
+  std::fprintf(fp, "\n  }\n");
+}
+
+void run_report_write(Settings &settings, bool valid) {
+  FILE *fp = std::fopen(settings.tea_report_filename, "w");
+  if (!fp) {
+    print_and_log(settings, "Warning: could not open the run report %s\n", settings.tea_report_filename);
+    return;
+  }
+
+  std::fprintf(fp, "{\n");
+  run_report_config(fp, settings);
+  run_report_decomposition(fp, settings);
+  run_report_timesteps(fp);
+  run_report_kernels(fp, settings);
+  run_report_result(fp, settings, valid);
+  std::fprintf(fp, "}\n");
+  std::fclose(fp);
+}
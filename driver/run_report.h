@@ -0,0 +1,40 @@
+#pragma once
+
+#include "settings.h"
+#include <vector>
+
+/*
+ *		RUN REPORT
+ *		Keeps the configuration, the solver statistics of every timestep and the final field summary
+ *		of a run in memory, and writes them once at exit as a single JSON document next to tea.out,
+ *		so that tools no longer need to scrape the log.
+ */
+
+// Records the node of every chunk, by cartesian rank, and the halo bytes one field exchange sends between nodes with the ranks in
+// their own order and as laid out, kept across run_report_reset as chunks are reused
+void run_report_mapping(int nodes, const std::vector<int> &cart_nodes, long identity_bytes, long mapped_bytes, bool mapped);
+
+// Records a completed timestep, wallclock being the time spent in this step alone
+void run_report_step(Settings &settings, int step, double dt, double error, double wallclock);
+
+// Records the field summary at the end of the solve, identical on all ranks
+void run_report_summary(double volume, double mass, double internal_energy, double temperature);
+
+// Records the comparison of the final temperature with the expected value from the test problems file
+void run_report_check(double expected, double difference, bool passed);
+
+// Writes the report to settings.tea_report_filename, called by the master only
+void run_report_write(Settings &settings, bool valid);
+
+// Totals of the recorded run, for drivers comparing many runs
+struct RunReportTotals {
+  int steps;
+  long iterations;
+  double temperature;
+  bool checked;
+  bool passed;
+};
+RunReportTotals run_report_totals();
+
+// Forgets the recorded run before the next one
+void run_report_reset();
@@ -1,12 +1,87 @@
 #include "chunk.h"
 #include "kernel_interface.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+// Sets the density and energy of every cell of the chunk, halos included, from the initial state file in place of the deck's
+// states: the density of the whole grid then its energy, as raw native doubles in rows from the bottom left cell. Each rank maps
+// the file and reads only the rows of its own chunk, halo cells past the edge of the grid taking the nearest edge cell
+static void import_chunk_state(Chunk *chunk, Settings &settings) {
+  const char *filename = settings.initial_state_file.c_str();
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    die(__LINE__, __FILE__, "Could not open initial state file %s\n", filename);
+  }
+  struct stat st {};
+  size_t cells = static_cast<size_t>(settings.grid_x_cells) * settings.grid_y_cells;
+  if (fstat(fd, &st) || static_cast<size_t>(st.st_size) != 2 * cells * sizeof(double)) {
+    die(__LINE__, __FILE__, "Initial state file %s should hold %zu bytes, the density and energy of %dx%d cells\n", filename,
+        2 * cells * sizeof(double), settings.grid_x_cells, settings.grid_y_cells);
+  }
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    die(__LINE__, __FILE__, "Could not map initial state file %s\n", filename);
+  }
+  const double *file_density = static_cast<const double *>(mapped);
+  const double *file_energy = file_density + cells;
+
+  // Host models take the fields in place, others through host copies
+  size_t len = static_cast<size_t>(chunk->x) * chunk->y;
+  std::vector<double> staging;
+  double *density = nullptr, *energy = nullptr, *u = nullptr;
+  if constexpr (std::is_same<FieldBufferType, double *>::value) {
+    if (settings.model_kind == ModelKind::Host) {
+      density = chunk->density;
+      energy = chunk->energy0;
+      u = chunk->u;
+    }
+  }
+  if (!density) {
+    staging.resize(3 * len);
+    density = &staging[0];
+    energy = &staging[len];
+    u = &staging[2 * len];
+  }
+
+  for (int jj = 0; jj < chunk->y; ++jj) {
+    int row = std::clamp(chunk->bottom + jj - settings.halo_depth, 0, settings.grid_y_cells - 1);
+    for (int kk = 0; kk < chunk->x; ++kk) {
+      int col = std::clamp(chunk->left + kk - settings.halo_depth, 0, settings.grid_x_cells - 1);
+      size_t cell = static_cast<size_t>(row) * settings.grid_x_cells + col;
+      density[kk + jj * chunk->x] = file_density[cell];
+      energy[kk + jj * chunk->x] = file_energy[cell];
+    }
+  }
+  munmap(mapped, st.st_size);
+
+  // As set by the state kernels, u starts as the energy density of the inner cells
+  for (int jj = 1; jj < chunk->y - 1; ++jj) {
+    for (int kk = 1; kk < chunk->x - 1; ++kk) {
+      u[kk + jj * chunk->x] = energy[kk + jj * chunk->x] * density[kk + jj * chunk->x];
+    }
+  }
+
+  if (!staging.empty()) {
+    run_field_from_host(chunk, settings, density, chunk->density);
+    run_field_from_host(chunk, settings, energy, chunk->energy0);
+    run_field_from_host(chunk, settings, u, chunk->u);
+  }
+}
 
 // Invokes the set chunk state kernel
 void set_chunk_state_driver(Chunk *chunks, Settings &settings, State *states) {
   // Issue kernel to all local chunks
   for (int cc = 0; cc < settings.num_chunks_per_rank; ++cc) {
     if (settings.kernel_language == Kernel_Language::C) {
-      run_set_chunk_state(&(chunks[cc]), settings, states);
+      if (settings.initial_state_file.empty()) run_set_chunk_state(&(chunks[cc]), settings, states);
+      else
+        import_chunk_state(&(chunks[cc]), settings);
     } else if (settings.kernel_language == Kernel_Language::FORTRAN) {
       // Fortran store energy kernel
     }
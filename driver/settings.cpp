@@ -1,4 +1,8 @@
 #include "settings.h"
+#include "bench_sweep.h"
+#include "ensemble.h"
+#include "rebalance.h"
+#include "trace.h"
 #include <cstring>
 
 #define MAX_CHAR_LEN 256
@@ -13,13 +17,32 @@ void set_default_settings(Settings &settings) {
   settings.tea_out_filename = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
   strncpy(settings.tea_out_filename, DEF_TEA_OUT_FILENAME, MAX_CHAR_LEN);
 
+  settings.tea_report_filename = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
+  strncpy(settings.tea_report_filename, DEF_TEA_REPORT_FILENAME, MAX_CHAR_LEN);
+
   settings.tea_visit_filename = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
   strncpy(settings.tea_visit_filename, DEF_TEA_VISIT_FILENAME, MAX_CHAR_LEN);
 
   settings.tea_vtk_path_name = (char *)malloc(sizeof(char) * MAX_CHAR_LEN);
   strncpy(settings.tea_vtk_path_name, DEF_TEA_VTK_PATHNAME, MAX_CHAR_LEN);
 
+  settings.trace_filename = nullptr;
+  settings.trace_capacity = DEF_TRACE_CAPACITY;
+
+  settings.bench_sweep_sizes = nullptr;
+  settings.bench_scaling = DEF_BENCH_SCALING;
+  settings.bench_iterations = DEF_BENCH_ITERATIONS;
+  settings.bench_output_filename = (char *)DEF_BENCH_OUTPUT_FILENAME;
+  settings.solve_iterations = 0;
+
+  settings.ensemble_filename = nullptr;
+  settings.ensemble_groups = DEF_ENSEMBLE_GROUPS;
+  settings.ensemble_output_filename = (char *)DEF_ENSEMBLE_OUTPUT_FILENAME;
+
   settings.tea_out_fp = nullptr;
+  settings.verbosity = DEF_VERBOSITY;
+  settings.log_buffered = DEF_LOG_BUFFERED;
+  settings.log_stdout = true;
   settings.grid_x_min = DEF_GRID_X_MIN;
   settings.grid_y_min = DEF_GRID_Y_MIN;
   settings.grid_x_max = DEF_GRID_X_MAX;
@@ -31,12 +54,28 @@ void set_default_settings(Settings &settings) {
   settings.eps = DEF_EPS;
   settings.end_time = DEF_END_TIME;
   settings.end_step = DEF_END_STEP;
+  settings.adaptive_timestep = DEF_ADAPTIVE_TIMESTEP;
+  settings.timestep_min = DEF_TIMESTEP_MIN;
+  settings.timestep_max = DEF_TIMESTEP_MAX;
+  settings.timestep_target_iterations = DEF_TIMESTEP_TARGET_ITERATIONS;
+  settings.sim_time = 0.0;
+  settings.sim_steps = 0;
   settings.summary_frequency = DEF_SUMMARY_FREQUENCY;
   settings.visit_frequency = DEF_VISIT_FREQUENCY;
+  settings.visit_format = DEF_VISIT_FORMAT;
+  settings.visit_downsample = DEF_VISIT_DOWNSAMPLE;
+  settings.visit_region = DEF_VISIT_REGION;
   settings.solver = DEF_SOLVER;
   settings.staging_buffer_preference = DEF_STAGING_BUFFER;
+  settings.halo_exchange = DEF_HALO_EXCHANGE;
+  settings.rank_mapping = DEF_RANK_MAPPING;
+  settings.shared_halos = DEF_SHARED_HALOS;
+  settings.datatype_halos = DEF_DATATYPE_HALOS;
+  settings.rebalance_steps = DEF_REBALANCE_STEPS;
+  settings.rebalance_threshold = DEF_REBALANCE_THRESHOLD;
   settings.model_name = "";
   settings.model_kind = ModelKind::Host;
+  settings.model_reinitialisable = true;
   settings.coefficient = DEF_COEFFICIENT;
   settings.error_switch = DEF_ERROR_SWITCH;
   settings.presteps = DEF_PRESTEPS;
@@ -45,6 +84,7 @@ void set_default_settings(Settings &settings) {
   settings.ppcg_inner_steps = DEF_PPCG_INNER_STEPS;
   settings.preconditioner = DEF_PRECONDITIONER;
   settings.num_states = DEF_NUM_STATES;
+  settings.volume_fraction_samples = DEF_VOLUME_FRACTION_SAMPLES;
   settings.num_chunks = DEF_NUM_CHUNKS;
   settings.num_chunks_per_rank = DEF_NUM_CHUNKS_PER_RANK;
   settings.num_ranks = DEF_NUM_RANKS;
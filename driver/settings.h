@@ -4,12 +4,14 @@
 #include "shared.h"
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #define NUM_FIELDS 6
 
 // Default settings
 #define DEF_TEA_IN_FILENAME "tea.in"
 #define DEF_TEA_OUT_FILENAME "target/tea.out"
+#define DEF_TEA_REPORT_FILENAME "target/tea.json"
 #define DEF_TEST_PROBLEM_FILENAME "tea.problems"
 #define DEF_TEA_VISIT_FILENAME "tea.visit"
 #define DEF_TEA_VTK_PATHNAME "target/vtk/"
@@ -34,8 +36,17 @@
 #define DEF_EPS 1.0E-15
 #define DEF_END_TIME 10.0
 #define DEF_END_STEP INT32_MAX
+#define DEF_ADAPTIVE_TIMESTEP false
+#define DEF_TIMESTEP_MIN 0.0
+#define DEF_TIMESTEP_MAX 0.0
+#define DEF_TIMESTEP_TARGET_ITERATIONS 0
+#define DEF_TIMESTEP_MAX_GROWTH 1.5
+#define DEF_TIMESTEP_MAX_SHRINK 0.5
 #define DEF_SUMMARY_FREQUENCY 10
 #define DEF_VISIT_FREQUENCY 0
+#define DEF_VISIT_FORMAT VisitFormat::ASCII
+#define DEF_VISIT_DOWNSAMPLE 1
+#define DEF_VISIT_REGION false
 #define DEF_KERNEL_LANGUAGE C
 #define DEF_COEFFICIENT CONDUCTIVITY
 #define DEF_ERROR_SWITCH 0
@@ -46,7 +57,14 @@
 #define DEF_PRECONDITIONER 0
 #define DEF_SOLVER Solver::CG_SOLVER
 #define DEF_STAGING_BUFFER StagingBuffer::AUTO
+#define DEF_HALO_EXCHANGE HaloExchange::BLOCKING
+#define DEF_RANK_MAPPING RankMapping::NODE
+#define DEF_SHARED_HALOS false
+#define DEF_DATATYPE_HALOS false
+#define DEF_VERBOSITY LOG_DETAIL
+#define DEF_LOG_BUFFERED true
 #define DEF_NUM_STATES 0
+#define DEF_VOLUME_FRACTION_SAMPLES 0
 #define DEF_NUM_CHUNKS 1
 #define DEF_NUM_CHUNKS_PER_RANK 1
 #define DEF_NUM_RANKS 1
@@ -64,6 +82,18 @@ enum class StagingBuffer { ENABLE, DISABLE, AUTO };
 
 enum class ModelKind { Host, Offload, Unified };
 
+// How each halo message is exchanged with a neighbour
+enum class HaloExchange { BLOCKING, NONBLOCKING, NEIGHBOURHOOD, RMA };
+
+// How ranks are placed on the cartesian grid of chunks
+enum class RankMapping { IDENTITY, NODE };
+
+// How the grid grows with the rank count in a benchmark sweep
+enum class BenchScaling { STRONG, WEAK };
+
+// The file format of visualisation dumps
+enum class VisitFormat { ASCII, RAW, ZLIB };
+
 // The main settings structure
 struct Settings {
   // Set of system-wide profiles
@@ -73,6 +103,9 @@ struct Settings {
 
   // Log files
   FILE *tea_out_fp;
+  int verbosity;
+  bool log_buffered;
+  bool log_stdout;
 
   int rank;
   int cart_rank;
@@ -87,6 +120,10 @@ struct Settings {
   int summary_frequency;
   int halo_depth;
   int num_states;
+  int volume_fraction_samples;
+
+  // Raw binary density and energy of the whole grid replacing the states, unused when empty
+  std::string initial_state_file;
   int num_chunks;
   int num_chunks_per_rank;
   int num_ranks;
@@ -103,15 +140,51 @@ struct Settings {
   double end_time;
   double eps_lim;
 
+  // Adaptive timestep control, bounds of zero are not applied
+  bool adaptive_timestep;
+  double timestep_min;
+  double timestep_max;
+  int timestep_target_iterations;
+
+  // Simulated time and timesteps reached by the latest solve
+  double sim_time;
+  int sim_steps;
+
   // Input-Output files
   char *tea_in_filename;
   char *tea_out_filename;
+  char *tea_report_filename;
   char *test_problem_filename;
 
   int visit_frequency;
+  VisitFormat visit_format;
+  int visit_downsample;
+  bool visit_region;
+  double visit_region_x_min;
+  double visit_region_y_min;
+  double visit_region_x_max;
+  double visit_region_y_max;
   char *tea_visit_filename;
   char *tea_vtk_path_name;
 
+  // Event trace, disabled unless a file is given
+  char *trace_filename;
+  int trace_capacity;
+
+  // Benchmark sweep, disabled unless grid sizes are given
+  char *bench_sweep_sizes;
+  BenchScaling bench_scaling;
+  int bench_iterations;
+  char *bench_output_filename;
+
+  // Ensemble of decks, disabled unless a case file is given
+  char *ensemble_filename;
+  int ensemble_groups;
+  char *ensemble_output_filename;
+
+  // Outer iterations taken by the latest solve
+  int solve_iterations;
+
   // Fault-tolerance config
   bool ft;
   int with_ft_kill_x;
@@ -128,8 +201,14 @@ struct Settings {
   char *device_selector;
   std::string model_name;
   ModelKind model_kind;
+  // Whether the kernels can be initialised again after being finalised
+  bool model_reinitialisable;
   StagingBuffer staging_buffer_preference;
   bool staging_buffer;
+  HaloExchange halo_exchange;
+  RankMapping rank_mapping;
+  bool shared_halos;
+  bool datatype_halos;
 
   // Field dimensions
   int grid_x_cells;
@@ -137,6 +216,14 @@ struct Settings {
   int grid_x_chunks;
   int grid_y_chunks;
 
+  // Cell edges of the chunk columns and rows once load balanced, empty for an even split
+  std::vector<int> chunk_x_edges;
+  std::vector<int> chunk_y_edges;
+
+  // Load balancing from the compute time of the first steps, disabled unless a step count is given
+  int rebalance_steps;
+  double rebalance_threshold;
+
   double grid_x_min;
   double grid_y_min;
   double grid_x_max;
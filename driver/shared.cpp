@@ -1,5 +1,6 @@
 #include "shared.h"
 #include "comms.h"
+#include <string>
 
 // Initialises the log file pointer
 void initialise_log(Settings &settings) {
@@ -17,6 +18,75 @@ void initialise_log(Settings &settings) {
   }
 }
 
+// The master's log output held back until the next flush, so that the solve never waits on stdout
+#define LOG_BUFFER_FLUSH_SIZE (1 << 16)
+static std::string log_stdout_buffer;
+static std::string log_file_buffer;
+static FILE *log_buffer_fp = nullptr;
+
+// Appends the formatted message to the buffer
+static void append_formatted(std::string &buffer, const char *format, va_list arglist) {
+  va_list arglist_copy;
+  va_copy(arglist_copy, arglist);
+  int length = std::vsnprintf(nullptr, 0, format, arglist_copy);
+  va_end(arglist_copy);
+  if (length <= 0) {
+    return;
+  }
+
+  size_t offset = buffer.size();
+  buffer.resize(offset + length + 1);
+  std::vsnprintf(&buffer[offset], length + 1, format, arglist);
+  buffer.resize(offset + length);
+}
+
+static void flush_log_buffers() {
+  if (!log_stdout_buffer.empty()) {
+    std::fwrite(log_stdout_buffer.data(), 1, log_stdout_buffer.size(), stdout);
+    std::fflush(stdout);
+    log_stdout_buffer.clear();
+  }
+  if (log_buffer_fp && !log_file_buffer.empty()) {
+    std::fwrite(log_file_buffer.data(), 1, log_file_buffer.size(), log_buffer_fp);
+    std::fflush(log_buffer_fp);
+  }
+  log_file_buffer.clear();
+}
+
+// Writes a message to the log file, and to stdout if requested, either immediately or through the buffers
+static void write_log(Settings &settings, bool to_stdout, const char *format, va_list arglist) {
+  to_stdout = to_stdout && settings.log_stdout;
+  if (!settings.tea_out_fp) {
+    die(__LINE__, __FILE__, "Attempted to write to log before it was initialised\n");
+  }
+
+  if (!settings.log_buffered) {
+    if (to_stdout) {
+      va_list arglist_copy;
+      va_copy(arglist_copy, arglist);
+      std::vprintf(format, arglist_copy);
+      va_end(arglist_copy);
+      std::fflush(stdout);
+    }
+    std::vfprintf(settings.tea_out_fp, format, arglist);
+    std::fflush(settings.tea_out_fp);
+    return;
+  }
+
+  log_buffer_fp = settings.tea_out_fp;
+  if (to_stdout) {
+    va_list arglist_copy;
+    va_copy(arglist_copy, arglist);
+    append_formatted(log_stdout_buffer, format, arglist_copy);
+    va_end(arglist_copy);
+  }
+  append_formatted(log_file_buffer, format, arglist);
+
+  if (log_file_buffer.size() >= LOG_BUFFER_FLUSH_SIZE) {
+    flush_log_buffers();
+  }
+}
+
 // Prints to stdout and then logs message in log file
 void print_and_log(Settings &settings, const char *format, ...) {
   // Only master rank should print
@@ -26,20 +96,20 @@ void print_and_log(Settings &settings, const char *format, ...) {
 
   va_list arglist;
   va_start(arglist, format);
-  std::vprintf(format, arglist);
+  write_log(settings, true, format, arglist);
   va_end(arglist);
-  std::fflush(stdout);
+}
 
-  if (!settings.tea_out_fp) {
-    die(__LINE__, __FILE__, "Attempted to write to log before it was initialised\n");
+// Prints and logs a message only if the verbosity includes its level
+void print_and_log_at(Settings &settings, int level, const char *format, ...) {
+  if (settings.rank != MASTER || level > settings.verbosity) {
+    return;
   }
 
-  // Obtuse, but necessary
-  va_list arglist2;
-  va_start(arglist2, format);
-  std::vfprintf(settings.tea_out_fp, format, arglist2);
-  va_end(arglist2);
-  std::fflush(settings.tea_out_fp);
+  va_list arglist;
+  va_start(arglist, format);
+  write_log(settings, true, format, arglist);
+  va_end(arglist);
 }
 
 // Logs message in log file
@@ -49,15 +119,31 @@ void print_to_log(Settings &settings, const char *format, ...) {
     return;
   }
 
-  if (!settings.tea_out_fp) {
-    die(__LINE__, __FILE__, "Attempted to write to log before it was initialised\n");
-  }
-
   va_list arglist;
   va_start(arglist, format);
-  std::vfprintf(settings.tea_out_fp, format, arglist);
+  write_log(settings, false, format, arglist);
   va_end(arglist);
-  std::fflush(settings.tea_out_fp);
+}
+
+// Writes out the buffered log, called at summary points and before anything else prints
+void flush_log(Settings &settings) {
+  if (settings.rank != MASTER) {
+    return;
+  }
+  flush_log_buffers();
+}
+
+// Flushes and closes the log file
+void finalise_log(Settings &settings) {
+  if (!settings.tea_out_fp) {
+    return;
+  }
+  if (settings.rank == MASTER) {
+    flush_log_buffers();
+    log_buffer_fp = nullptr;
+  }
+  std::fclose(settings.tea_out_fp);
+  settings.tea_out_fp = nullptr;
 }
 
 // Plots a two-dimensional dat file.
@@ -84,6 +170,9 @@ void plot_2d(int x, int y, const double *buffer, const char *name) {
 
 // Aborts the application.
 void die(int lineNum, const char *file, const char *format, ...) {
+  // Keep the log leading up to the error
+  flush_log_buffers();
+
   // Print location of error
   std::printf("\x1b[31m");
   std::printf("\nError at line %d in %s:", lineNum, file);
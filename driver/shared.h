@@ -16,6 +16,9 @@ struct Settings;
 void initialise_log(Settings &settings);
 void print_to_log(Settings &settings, const char *format, ...);
 void print_and_log(Settings &settings, const char *format, ...);
+void print_and_log_at(Settings &settings, int level, const char *format, ...);
+void flush_log(Settings &settings);
+void finalise_log(Settings &settings);
 void plot_2d(int x, int y, const double *buffer, const char *name);
 void die(int lineNum, const char *file, const char *format, ...);
 
@@ -29,6 +32,11 @@ void write_to_visit(int nx, int ny, int x_off, int y_off, const double *data, co
 // Global constants
 #define MASTER 0
 
+// Log verbosity, messages of a level above the configured verbosity are dropped
+#define LOG_QUIET 0
+#define LOG_STEP 1
+#define LOG_DETAIL 2
+
 #define NUM_FACES 4
 #define CHUNK_LEFT 0
 #define CHUNK_RIGHT 1
@@ -0,0 +1,133 @@
+#include "trace.h"
+#include "comms.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum class TraceEventKind { Region, Message };
+
+struct TraceEvent {
+  TraceEventKind kind;
+  int thread;
+  int id;
+  int arg;
+  double start;
+  double end;
+};
+
+bool trace_active = false;
+
+static std::vector<TraceEvent> trace_events;
+static std::atomic<uint64_t> trace_next{0};
+static double trace_origin = 0.0;
+
+static std::atomic<int> trace_thread_count{0};
+static thread_local int trace_thread_index = -1;
+
+void trace_initialise(Settings &settings) {
+  if (!settings.trace_filename) return;
+
+#ifdef ENABLE_PROFILING
+  trace_events.resize(settings.trace_capacity);
+
+  // Ranks leave the barrier at about the same time, which lines their timelines up
+  barrier();
+  trace_origin = profiler_now();
+  trace_active = true;
+#else
+  print_and_log(settings, "Warning: built without profiling, no events will be traced\n");
+#endif
+}
+
+// Claims a slot without locking, the oldest events are overwritten once the buffer is full
+static void trace_record(const TraceEvent &event) {
+  uint64_t slot = trace_next.fetch_add(1, std::memory_order_relaxed);
+  trace_events[slot % trace_events.size()] = event;
+}
+
+static int trace_thread() {
+  if (trace_thread_index < 0) {
+    trace_thread_index = trace_thread_count++;
+  }
+  return trace_thread_index;
+}
+
+void trace_record_region(int region, double start, double end) {
+  trace_record({TraceEventKind::Region, trace_thread(), region, 0, start, end});
+}
+
+void trace_record_message(int neighbour_rank, int buffer_len) {
+  double now = profiler_now();
+  trace_record({TraceEventKind::Message, trace_thread(), neighbour_rank, buffer_len, now, now});
+}
+
+// Serialises the retained events of this rank as comma-separated Chrome trace events, timestamps in microseconds
+static std::string trace_serialise(Settings &settings) {
+  uint64_t recorded = trace_next.load();
+  uint64_t retained = std::min<uint64_t>(recorded, trace_events.size());
+
+  std::ostringstream out;
+  out.precision(3);
+  out << std::fixed;
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << settings.rank << ",\"args\":{\"name\":\"rank " << settings.rank << " ("
+      << settings.cart_coords[X_AXIS] << "," << settings.cart_coords[Y_AXIS] << ")\"}}";
+  // Messages record the cartesian rank of the neighbour, named by its world rank like the processes of the trace
+  std::vector<int> world_ranks(settings.num_ranks);
+  get_cart_world_ranks(settings.num_ranks, world_ranks.data());
+
+  out << ",{\"name\":\"process_labels\",\"ph\":\"M\",\"pid\":" << settings.rank << ",\"args\":{\"labels\":\"" << recorded - retained
+      << " events dropped\"}}";
+
+  for (uint64_t ee = recorded - retained; ee < recorded; ++ee) {
+    const TraceEvent &event = trace_events[ee % trace_events.size()];
+    out << ",{\"pid\":" << settings.rank << ",\"tid\":" << event.thread << ",\"ts\":" << (event.start - trace_origin) * 1.0E6;
+    if (event.kind == TraceEventKind::Region) {
+      out << ",\"ph\":\"X\",\"dur\":" << (event.end - event.start) * 1.0E6 << ",\"name\":\"" << profiler_region_name(event.id) << "\"}";
+    } else {
+      out << ",\"ph\":\"i\",\"s\":\"t\",\"name\":\"halo_message\",\"args\":{\"neighbour\":" << world_ranks[event.id]
+          << ",\"bytes\":" << event.arg * sizeof(double) << "}}";
+    }
+  }
+  return out.str();
+}
+
+void trace_finalise(Settings &settings) {
+  if (!trace_active) return;
+  trace_active = false;
+
+  std::string events = trace_serialise(settings);
+  int events_len = static_cast<int>(events.size());
+
+  bool is_master = settings.rank == MASTER;
+  std::vector<int> rank_events_len(is_master ? settings.num_ranks : 0);
+  MPI_Gather(&events_len, 1, MPI_INT, rank_events_len.data(), 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+
+  std::vector<int> displs(rank_events_len.size());
+  std::exclusive_scan(rank_events_len.begin(), rank_events_len.end(), displs.begin(), 0);
+  std::vector<char> all_events(is_master ? displs.back() + rank_events_len.back() : 0);
+  MPI_Gatherv(events.data(), events_len, MPI_CHAR, all_events.data(), rank_events_len.data(), displs.data(), MPI_CHAR, MASTER,
+              MPI_COMM_WORLD);
+
+  trace_events.clear();
+  trace_events.shrink_to_fit();
+  if (!is_master) return;
+
+  std::ofstream out(settings.trace_filename, std::ofstream::out);
+  if (!out) {
+    die(__LINE__, __FILE__, "Could not open trace file %s\n", settings.trace_filename);
+  }
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (int rr = 0; rr < settings.num_ranks; ++rr) {
+    if (rr) out << ",\n";
+    out.write(all_events.data() + displs[rr], rank_events_len[rr]);
+  }
+  out << "]}\n";
+
+  print_and_log(settings, "Trace written to %s\n", settings.trace_filename);
+}
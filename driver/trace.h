@@ -0,0 +1,38 @@
+#pragma once
+
+#include "settings.h"
+
+/*
+ *		EVENT TRACE
+ *		Records profiled regions and halo messages into a bounded, lock-free ring buffer per rank.
+ *		Nothing is written during the solve: all ranks' events are merged into one Chrome/Perfetto
+ *		JSON trace at exit.
+ */
+
+#define DEF_TRACE_CAPACITY (1 << 18)
+
+extern bool trace_active;
+
+// Allocates the ring buffer and aligns the time origin across ranks, collective over all ranks
+void trace_initialise(Settings &settings);
+
+// Gathers every rank's events on the master, which writes the trace file, collective over all ranks
+void trace_finalise(Settings &settings);
+
+// A completed region, timed with profiler_now()
+void trace_record_region(int region, double start, double end);
+
+// A halo message exchanged with a neighbour, recorded as an instant
+void trace_record_message(int neighbour_rank, int buffer_len);
+
+// Allows compile-time optimised conditional tracing, regions are only recorded through the profiler
+#ifdef ENABLE_PROFILING
+  #define TRACE_MESSAGE(neighbour_rank, buffer_len)                      \
+    do {                                                                 \
+      if (trace_active) trace_record_message(neighbour_rank, buffer_len); \
+    } while (false)
+#else
+  #define TRACE_MESSAGE(neighbour_rank, buffer_len) \
+    do {                                            \
+    } while (false)
+#endif
@@ -0,0 +1,418 @@
+#include "vtk_writer.h"
+#include "application.h"
+#include "comms.h"
+#include "shared.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef ENABLE_ZLIB
+  #include <zlib.h>
+#endif
+
+#define VTK_ZLIB_BLOCK_SIZE (1 << 20)
+
+static std::thread vtk_writer_thread;
+static std::mutex vtk_writer_mutex;
+static std::condition_variable vtk_writer_cv;
+static std::deque<VtkSnapshot> vtk_writer_queue;
+static int vtk_writer_in_flight = 0;
+static bool vtk_writer_running = false;
+static bool vtk_writer_stopping = false;
+
+// First failure of the writer thread, raised by the main thread since die aborts through MPI
+static std::string vtk_writer_error;
+
+std::string vtk_piece_filename(int x, int y, int time_step, VisitFormat format) {
+  std::ostringstream filename;
+  filename << "tea." << std::setfill('0') << std::setw(5) << x;
+  filename << "." << std::setfill('0') << std::setw(5) << y;
+  filename << "." << std::setfill('0') << std::setw(5) << time_step;
+  filename << (format == VisitFormat::ASCII ? ".vtk" : ".vtr");
+  return filename.str();
+}
+
+std::string vtk_index_filename(int time_step) {
+  std::ostringstream filename;
+  filename << "tea." << std::setfill('0') << std::setw(5) << time_step << ".pvtr";
+  return filename.str();
+}
+
+// Maps the chunks along one axis to their cropped cell windows and downsampled output ranges. Every chunk is
+// downsampled on its own, with a possibly partial last block, so no cells are ever needed from a neighbour.
+static void vtk_axis_extents(const Settings &settings, int axis, int chunk, int *window_lo, int *window_hi, int *out_lo,
+                             int *out_hi) {
+  int num_cells = axis == X_AXIS ? settings.grid_x_cells : settings.grid_y_cells;
+  int region_lo = 0;
+  int region_hi = num_cells;
+  if (settings.visit_region) {
+    double grid_min = axis == X_AXIS ? settings.grid_x_min : settings.grid_y_min;
+    double d = axis == X_AXIS ? settings.dx : settings.dy;
+    double region_min = axis == X_AXIS ? settings.visit_region_x_min : settings.visit_region_y_min;
+    double region_max = axis == X_AXIS ? settings.visit_region_x_max : settings.visit_region_y_max;
+    region_lo = std::clamp((int)std::floor((region_min - grid_min) / d), 0, num_cells);
+    region_hi = std::clamp((int)std::ceil((region_max - grid_min) / d), 0, num_cells);
+  }
+
+  int offset = 0;
+  for (int cc = 0; cc <= chunk; ++cc) {
+    int left, right, bottom, top;
+    calc_chunk_extents(settings, axis == X_AXIS ? cc : 0, axis == Y_AXIS ? cc : 0, &left, &right, &bottom, &top);
+    int lo = axis == X_AXIS ? left : bottom;
+    int hi = axis == X_AXIS ? right : top;
+
+    int cropped_lo = std::max(lo, region_lo);
+    int cropped_hi = std::min(hi, region_hi);
+    int num_out = cropped_hi > cropped_lo ? (cropped_hi - cropped_lo + settings.visit_downsample - 1) / settings.visit_downsample : 0;
+
+    if (cc == chunk) {
+      *window_lo = cropped_lo - lo;
+      *window_hi = std::max(cropped_hi, cropped_lo) - lo;
+      *out_lo = offset;
+      *out_hi = offset + num_out;
+    }
+    offset += num_out;
+  }
+}
+
+bool vtk_piece_extents(const Settings &settings, int xx, int yy, VtkPieceExtents *extents) {
+  vtk_axis_extents(settings, X_AXIS, xx, &extents->window_left, &extents->window_right, &extents->left, &extents->right);
+  vtk_axis_extents(settings, Y_AXIS, yy, &extents->window_bottom, &extents->window_top, &extents->bottom, &extents->top);
+  return extents->right > extents->left && extents->top > extents->bottom;
+}
+
+bool vtk_snapshot_initialise(VtkSnapshot &snapshot, int time_step, Chunk *chunk, Settings &settings) {
+  snapshot.time_step = time_step;
+  snapshot.format = settings.visit_format;
+  snapshot.path_name = settings.tea_vtk_path_name;
+  snapshot.chunk_x = settings.cart_coords[X_AXIS];
+  snapshot.chunk_y = settings.cart_coords[Y_AXIS];
+  snapshot.downsample = settings.visit_downsample;
+
+  VtkPieceExtents &extents = snapshot.extents;
+  if (!vtk_piece_extents(settings, snapshot.chunk_x, snapshot.chunk_y, &extents)) {
+    return false;
+  }
+
+  // Block boundaries, clipped to the cropped window
+  int k = settings.visit_downsample;
+  snapshot.x_coords.resize(extents.right - extents.left + 1);
+  for (int ii = 0; ii <= extents.right - extents.left; ++ii) {
+    int xx = chunk->left + std::min(extents.window_left + ii * k, extents.window_right);
+    snapshot.x_coords[ii] = settings.grid_x_min + settings.dx * ((double)xx);
+  }
+  snapshot.y_coords.resize(extents.top - extents.bottom + 1);
+  for (int jj = 0; jj <= extents.top - extents.bottom; ++jj) {
+    int yy = chunk->bottom + std::min(extents.window_bottom + jj * k, extents.window_top);
+    snapshot.y_coords[jj] = settings.grid_y_min + settings.dy * ((double)yy);
+  }
+
+  size_t num_cells = (size_t)(extents.window_right - extents.window_left) * (extents.window_top - extents.window_bottom);
+  snapshot.density.resize(num_cells);
+  snapshot.energy.resize(num_cells);
+  snapshot.temperature.resize(num_cells);
+  return true;
+}
+
+void vtk_snapshot_copy_window(VtkSnapshot &snapshot, std::vector<double> &dest, const double *field, Chunk *chunk, Settings &settings) {
+  const VtkPieceExtents &extents = snapshot.extents;
+  int window_x = extents.window_right - extents.window_left;
+  for (int jj = extents.window_bottom; jj < extents.window_top; ++jj) {
+    const double *row = field + (jj + settings.halo_depth) * chunk->x + settings.halo_depth + extents.window_left;
+    std::copy(row, row + window_x, dest.begin() + (size_t)(jj - extents.window_bottom) * window_x);
+  }
+}
+
+// Averages the cropped fields over k x k blocks, in place, off the solver's critical path
+static void downsample(VtkSnapshot &snapshot) {
+  int k = snapshot.downsample;
+  if (k == 1) return;
+
+  const VtkPieceExtents &extents = snapshot.extents;
+  int window_x = extents.window_right - extents.window_left;
+  int window_y = extents.window_top - extents.window_bottom;
+  int out_x = extents.right - extents.left;
+  int out_y = extents.top - extents.bottom;
+
+  for (std::vector<double> *field : {&snapshot.density, &snapshot.energy, &snapshot.temperature}) {
+    std::vector<double> coarse((size_t)out_x * out_y);
+    for (int jj = 0; jj < out_y; ++jj) {
+      for (int ii = 0; ii < out_x; ++ii) {
+        double sum = 0.0;
+        int count = 0;
+        for (int yy = jj * k; yy < std::min((jj + 1) * k, window_y); ++yy) {
+          for (int xx = ii * k; xx < std::min((ii + 1) * k, window_x); ++xx) {
+            sum += (*field)[(size_t)yy * window_x + xx];
+            count++;
+          }
+        }
+        coarse[(size_t)jj * out_x + ii] = sum / count;
+      }
+    }
+    field->swap(coarse);
+  }
+}
+
+// Writes the legacy ASCII rectilinear grid format
+static void write_ascii(std::ofstream &out, const VtkSnapshot &snapshot) {
+  int dim_x = snapshot.extents.right - snapshot.extents.left;
+  int dim_y = snapshot.extents.top - snapshot.extents.bottom;
+
+  out << "# vtk DataFile Version 5.1\n";
+  out << "vtk output\n";
+  out << "ASCII\n";
+  out << "DATASET RECTILINEAR_GRID\n";
+  out << "DIMENSIONS " << dim_x + 1 << " " << dim_y + 1 << " 1\n";
+
+  out << std::scientific << std::setprecision(4);
+  out << "X_COORDINATES " << dim_x + 1 << " double\n";
+  for (double x : snapshot.x_coords) {
+    out << std::setw(12) << x << " ";
+  }
+  out << "\n";
+
+  out << "Y_COORDINATES " << dim_y + 1 << " double\n";
+  for (double y : snapshot.y_coords) {
+    out << std::setw(12) << y << " ";
+  }
+  out << "\n";
+
+  out << "Z_COORDINATES 1 double\n";
+  out << "0\n";
+
+  out << "CELL_DATA " << dim_x * dim_y << "\n";
+  out << "FIELD FieldData 3\n";
+
+  const std::pair<const char *, const std::vector<double> *> fields[] = {
+      {"density", &snapshot.density}, {"energy", &snapshot.energy}, {"temperature", &snapshot.temperature}};
+  for (const auto &field : fields) {
+    out << field.first << " 1 " << dim_x * dim_y << " double\n";
+    for (double value : *field.second) {
+      out << std::setw(12) << value << "\n";
+    }
+  }
+}
+
+// Encodes an array as a raw appended block: UInt64 byte count followed by the data
+static void encode_raw(std::string &appended, const std::vector<double> &data) {
+  uint64_t num_bytes = data.size() * sizeof(double);
+  appended.append(reinterpret_cast<const char *>(&num_bytes), sizeof(num_bytes));
+  appended.append(reinterpret_cast<const char *>(data.data()), num_bytes);
+}
+
+#ifdef ENABLE_ZLIB
+// Encodes an array following vtkZLibDataCompressor: a block header followed by the compressed blocks, false if compression fails
+static bool encode_zlib(std::string &appended, const std::vector<double> &data) {
+  uint64_t num_bytes = data.size() * sizeof(double);
+  uint64_t num_blocks = num_bytes ? (num_bytes + VTK_ZLIB_BLOCK_SIZE - 1) / VTK_ZLIB_BLOCK_SIZE : 0;
+  uint64_t last_block_size = num_bytes % VTK_ZLIB_BLOCK_SIZE;
+
+  std::vector<uint64_t> header(3 + num_blocks);
+  header[0] = num_blocks;
+  header[1] = VTK_ZLIB_BLOCK_SIZE;
+  header[2] = last_block_size;
+
+  std::string blocks;
+  std::vector<Bytef> compressed(compressBound(VTK_ZLIB_BLOCK_SIZE));
+  const auto *source = reinterpret_cast<const Bytef *>(data.data());
+  for (uint64_t bb = 0; bb < num_blocks; ++bb) {
+    uLong block_size = (bb == num_blocks - 1 && last_block_size) ? last_block_size : VTK_ZLIB_BLOCK_SIZE;
+    uLongf compressed_size = compressed.size();
+    if (compress2(compressed.data(), &compressed_size, source + bb * VTK_ZLIB_BLOCK_SIZE, block_size, Z_BEST_SPEED) != Z_OK) {
+      return false;
+    }
+    header[3 + bb] = compressed_size;
+    blocks.append(reinterpret_cast<const char *>(compressed.data()), compressed_size);
+  }
+
+  appended.append(reinterpret_cast<const char *>(header.data()), header.size() * sizeof(uint64_t));
+  appended.append(blocks);
+  return true;
+}
+#endif
+
+// Writes the XML rectilinear grid format with all arrays in a single appended section, false if an array fails to encode
+static bool write_xml(std::ofstream &out, const VtkSnapshot &snapshot) {
+  bool compressed = snapshot.format == VisitFormat::ZLIB;
+#ifndef ENABLE_ZLIB
+  compressed = false;
+#endif
+
+  const std::vector<double> z_coords{0.0};
+  const std::pair<const char *, const std::vector<double> *> cell_arrays[] = {
+      {"density", &snapshot.density}, {"energy", &snapshot.energy}, {"temperature", &snapshot.temperature}};
+  const std::pair<const char *, const std::vector<double> *> coord_arrays[] = {
+      {"x", &snapshot.x_coords}, {"y", &snapshot.y_coords}, {"z", &z_coords}};
+
+  std::string appended;
+  auto encode = [&](const std::vector<double> &data) {
+#ifdef ENABLE_ZLIB
+    if (compressed) return encode_zlib(appended, data);
+#endif
+    encode_raw(appended, data);
+    return true;
+  };
+
+  size_t offsets[6];
+  int aa = 0;
+  for (const auto &array : cell_arrays) {
+    offsets[aa++] = appended.size();
+    if (!encode(*array.second)) return false;
+  }
+  for (const auto &array : coord_arrays) {
+    offsets[aa++] = appended.size();
+    if (!encode(*array.second)) return false;
+  }
+
+  std::ostringstream extent;
+  extent << snapshot.extents.left << " " << snapshot.extents.right << " " << snapshot.extents.bottom << " " << snapshot.extents.top
+         << " 0 0";
+
+  out << "<?xml version=\"1.0\"?>\n";
+  out << "<VTKFile type=\"RectilinearGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\"";
+  if (compressed) out << " compressor=\"vtkZLibDataCompressor\"";
+  out << ">\n";
+  out << "  <RectilinearGrid WholeExtent=\"" << extent.str() << "\">\n";
+  out << "    <Piece Extent=\"" << extent.str() << "\">\n";
+  out << "      <CellData Scalars=\"density\">\n";
+  aa = 0;
+  for (const auto &array : cell_arrays) {
+    out << "        <DataArray type=\"Float64\" Name=\"" << array.first << "\" format=\"appended\" offset=\"" << offsets[aa++]
+        << "\"/>\n";
+  }
+  out << "      </CellData>\n";
+  out << "      <Coordinates>\n";
+  for (const auto &array : coord_arrays) {
+    out << "        <DataArray type=\"Float64\" Name=\"" << array.first << "\" format=\"appended\" offset=\"" << offsets[aa++]
+        << "\"/>\n";
+  }
+  out << "      </Coordinates>\n";
+  out << "    </Piece>\n";
+  out << "  </RectilinearGrid>\n";
+  out << "  <AppendedData encoding=\"raw\">\n";
+  out << "   _";
+  out.write(appended.data(), appended.size());
+  out << "\n  </AppendedData>\n";
+  out << "</VTKFile>\n";
+  return true;
+}
+
+// Writes a snapshot on the writer thread, returning an error message for the main thread, empty on success
+static std::string write_snapshot(VtkSnapshot &snapshot) {
+  downsample(snapshot);
+
+  std::string filename =
+      snapshot.path_name + vtk_piece_filename(snapshot.chunk_x, snapshot.chunk_y, snapshot.time_step, snapshot.format);
+  std::ofstream out(filename, std::ofstream::out | std::ofstream::binary);
+  if (!out) {
+    return "Could not open VTK file " + filename + "\n";
+  }
+
+  if (snapshot.format == VisitFormat::ASCII) {
+    write_ascii(out, snapshot);
+  } else if (!write_xml(out, snapshot)) {
+    return "Failed to compress VTK data block of " + filename + ".\n";
+  }
+  return "";
+}
+
+// Writer thread body: drains the queue until asked to stop
+static void vtk_writer_loop() {
+  std::unique_lock<std::mutex> lock(vtk_writer_mutex);
+  while (true) {
+    vtk_writer_cv.wait(lock, [] { return vtk_writer_stopping || !vtk_writer_queue.empty(); });
+    if (vtk_writer_queue.empty()) break;
+
+    VtkSnapshot snapshot = std::move(vtk_writer_queue.front());
+    vtk_writer_queue.pop_front();
+    vtk_writer_in_flight++;
+
+    lock.unlock();
+    std::string error = write_snapshot(snapshot);
+    lock.lock();
+
+    if (vtk_writer_error.empty()) vtk_writer_error = error;
+
+    vtk_writer_in_flight--;
+    vtk_writer_cv.notify_all();
+  }
+}
+
+void vtk_writer_submit(VtkSnapshot &&snapshot) {
+  std::unique_lock<std::mutex> lock(vtk_writer_mutex);
+  if (!vtk_writer_error.empty()) {
+    lock.unlock();
+    vtk_writer_finalise();
+  }
+  if (!vtk_writer_running) {
+    vtk_writer_stopping = false;
+    vtk_writer_thread = std::thread(vtk_writer_loop);
+    vtk_writer_running = true;
+  }
+
+  // Back-pressure: bound the memory held by snapshots waiting to be written
+  vtk_writer_cv.wait(lock, [] { return vtk_writer_queue.size() + vtk_writer_in_flight < VTK_WRITER_MAX_PENDING; });
+  vtk_writer_queue.push_back(std::move(snapshot));
+  vtk_writer_cv.notify_all();
+}
+
+void vtk_writer_finalise() {
+  {
+    std::lock_guard<std::mutex> lock(vtk_writer_mutex);
+    if (!vtk_writer_running) return;
+    vtk_writer_stopping = true;
+  }
+  vtk_writer_cv.notify_all();
+  vtk_writer_thread.join();
+  vtk_writer_running = false;
+
+  if (!vtk_writer_error.empty()) {
+    die(__LINE__, __FILE__, "%s", vtk_writer_error.c_str());
+  }
+}
+
+void vtk_write_parallel_index(int time_step, Settings &settings) {
+  std::string filename = std::string(settings.tea_vtk_path_name) + vtk_index_filename(time_step);
+  std::ofstream out(filename, std::ofstream::out);
+  if (!out) {
+    die(__LINE__, __FILE__, "Could not open VTK file %s\n", filename.c_str());
+  }
+
+  out << "<?xml version=\"1.0\"?>\n";
+  out << "<VTKFile type=\"PRectilinearGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">\n";
+  // The last chunk along each axis closes the whole extent
+  VtkPieceExtents whole;
+  vtk_axis_extents(settings, X_AXIS, settings.grid_x_chunks - 1, &whole.window_left, &whole.window_right, &whole.left, &whole.right);
+  vtk_axis_extents(settings, Y_AXIS, settings.grid_y_chunks - 1, &whole.window_bottom, &whole.window_top, &whole.bottom, &whole.top);
+  out << "  <PRectilinearGrid WholeExtent=\"0 " << whole.right << " 0 " << whole.top << " 0 0\" GhostLevel=\"0\">\n";
+  out << "    <PCellData Scalars=\"density\">\n";
+  for (const char *name : {"density", "energy", "temperature"}) {
+    out << "      <PDataArray type=\"Float64\" Name=\"" << name << "\"/>\n";
+  }
+  out << "    </PCellData>\n";
+  out << "    <PCoordinates>\n";
+  for (const char *name : {"x", "y", "z"}) {
+    out << "      <PDataArray type=\"Float64\" Name=\"" << name << "\"/>\n";
+  }
+  out << "    </PCoordinates>\n";
+
+  for (int yy = 0; yy < settings.grid_y_chunks; ++yy) {
+    for (int xx = 0; xx < settings.grid_x_chunks; ++xx) {
+      VtkPieceExtents extents;
+      if (!vtk_piece_extents(settings, xx, yy, &extents)) continue;
+      out << "    <Piece Extent=\"" << extents.left << " " << extents.right << " " << extents.bottom << " " << extents.top
+          << " 0 0\" Source=\"" << vtk_piece_filename(xx, yy, time_step, settings.visit_format) << "\"/>\n";
+    }
+  }
+
+  out << "  </PRectilinearGrid>\n";
+  out << "</VTKFile>\n";
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "chunk.h"
+#include "settings.h"
+#include <string>
+#include <vector>
+
+/*
+ *		VTK WRITER
+ *		Serialises visualisation dumps on a dedicated background thread.
+ */
+
+#define VTK_WRITER_MAX_PENDING 4
+
+// Output window of a chunk, once cropped to the visit region and downsampled
+struct VtkPieceExtents {
+  // Cropped cells, relative to the chunk interior
+  int window_left;
+  int window_right;
+  int window_bottom;
+  int window_top;
+
+  // Global point extents of the output piece
+  int left;
+  int right;
+  int bottom;
+  int top;
+};
+
+// Host-side copy of the visualisation fields of a single chunk at a given time step
+struct VtkSnapshot {
+  int time_step;
+  VisitFormat format;
+  std::string path_name;
+
+  // Cartesian coordinates of the owning rank
+  int chunk_x;
+  int chunk_y;
+
+  VtkPieceExtents extents;
+  int downsample;
+
+  std::vector<double> x_coords;
+  std::vector<double> y_coords;
+
+  // Cropped fields at full resolution, downsampled by the writer thread
+  std::vector<double> density;
+  std::vector<double> energy;
+  std::vector<double> temperature;
+};
+
+// Computes the output window of the chunk at the given cartesian coordinates, false if it lies outside the visit region
+bool vtk_piece_extents(const Settings &settings, int xx, int yy, VtkPieceExtents *extents);
+
+// Sets up extents, coordinates and field storage of a snapshot, false if the chunk has nothing to output
+bool vtk_snapshot_initialise(VtkSnapshot &snapshot, int time_step, Chunk *chunk, Settings &settings);
+
+// Copies the cropped window of a host-resident field into a snapshot array
+void vtk_snapshot_copy_window(VtkSnapshot &snapshot, std::vector<double> &dest, const double *field, Chunk *chunk, Settings &settings);
+
+// Hands a snapshot over to the writer thread, blocks only if too many dumps are still pending. Dies if an earlier dump failed
+void vtk_writer_submit(VtkSnapshot &&snapshot);
+
+// Waits for all pending dumps to be written and stops the writer thread, then dies if any of them failed
+void vtk_writer_finalise();
+
+// Writes the parallel index listing every rank's piece for a time step, computed without any communication
+void vtk_write_parallel_index(int time_step, Settings &settings);
+
+std::string vtk_piece_filename(int x, int y, int time_step, VisitFormat format);
+std::string vtk_index_filename(int time_step);
@@ -200,6 +200,12 @@ def write_vtk_file(iter, destination, vtk_out, binary_format=False):
 
 
 def main(input_dir, output_dir, output_prefix, binary_format, grid_y_chunks):
+    # XML dumps come with a parallel index per iteration, which viewers open directly
+    pvtr_filenames = glob.glob(f"{input_dir}/*.pvtr")
+    if pvtr_filenames:
+        log.info(f"Found {len(pvtr_filenames)} parallel VTK index files: open them directly, no merge is needed.")
+        return
+
     # Get list of VTK files in the input directory
     vtk_filenames = glob.glob(f"{input_dir}/*.vtk")
     if not vtk_filenames:
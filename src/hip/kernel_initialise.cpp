@@ -263,3 +263,14 @@ void run_kernel_finalise(Chunk *chunk, Settings &) {
   std::free(chunk->cheby_alphas);
   std::free(chunk->cheby_betas);
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  hipMemcpy(host, field, sizeof(double) * chunk->x * chunk->y, CLOVER_MEMCPY_KIND_D2H);
+  check_errors(__LINE__, __FILE__);
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  hipMemcpy(field, host, sizeof(double) * chunk->x * chunk->y, CLOVER_MEMCPY_KIND_H2D);
+  check_errors(__LINE__, __FILE__);
+}
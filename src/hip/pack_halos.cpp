@@ -2,6 +2,7 @@
 
 #include "chunk.h"
 #include "comms.h"
+#include "halo_strips.h"
 #include "cuknl_shared.h"
 
 __global__ void pack_left(const int x, const int y, const int depth, const int halo_depth, const double *field, double *buffer,
@@ -144,6 +145,34 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+// Packs or unpacks the cells of every strip, one thread per cell
+__global__ void pack_or_unpack_strips(const int x, const HaloStrips strips, const bool pack) {
+  const int gid = threadIdx.x + blockDim.x * blockIdx.x;
+  if (gid >= strips.cells) return;
+
+  int ss = 0;
+  while (gid >= strips.strip[ss].last) {
+    ++ss;
+  }
+  const HaloStrip &s = strips.strip[ss];
+  const int cell = gid - s.first;
+  const int index = s.field_start + (cell / s.cols) * x + cell % s.cols;
+  if (pack) s.buffer[s.buffer_start + cell] = s.field[index];
+  else
+    s.field[index] = s.buffer[s.buffer_start + cell];
+}
+
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  START_PROFILING(settings.kernel_profile);
+  const int x_inner = chunk->x - 2 * settings.halo_depth;
+  const int y_inner = chunk->y - 2 * settings.halo_depth;
+  HaloStrips strips = halo_strips(chunk->x, chunk->y, depth, settings.halo_depth, pack, fields, buffers, {0, y_inner}, {0, x_inner});
+  int num_blocks = std::ceil(strips.cells / double(BLOCK_SIZE));
+  if (num_blocks > 0) pack_or_unpack_strips<<<num_blocks, BLOCK_SIZE>>>(chunk->x, strips, pack);
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
 void run_send_recv_halo(Chunk *, Settings &settings,                                                            //
                         FieldBufferType src_send_buffer, FieldBufferType src_recv_buffer,                       //
                         StagingBufferType dest_staging_send_buffer, StagingBufferType dest_staging_recv_buffer, //
@@ -134,6 +134,8 @@ void run_model_info(Settings &settings) {
   settings.model_name = "Kokkos" + std::to_string(KOKKOS_VERSION / 10000) + "." + std::to_string(KOKKOS_VERSION / 100 % 100) + "." +
                         std::to_string(KOKKOS_VERSION % 100);
   settings.model_kind = ModelKind::Offload;
+  // Kokkos may only be initialised once per process
+  settings.model_reinitialisable = false;
 }
 
 void run_kernel_initialise(Chunk *chunk, Settings &settings, int comms_lr_len, int comms_tb_len) {
@@ -201,3 +203,14 @@ void run_kernel_finalise(Chunk *chunk, Settings &) {
   // TODO: Actually shouldn't be called on a per chunk basis, only by rank
   Kokkos::finalize();
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  Kokkos::View<double *, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged>> dest(host, chunk->x * chunk->y);
+  Kokkos::deep_copy(dest, *field);
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  Kokkos::View<const double *, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged>> source(host, chunk->x * chunk->y);
+  Kokkos::deep_copy(*field, source);
+}
@@ -1,5 +1,6 @@
 #include "chunk.h"
 #include "comms.h"
+#include "halo_strips.h"
 #include "kokkos_shared.hpp"
 #include "shared.h"
 
@@ -107,6 +108,35 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  START_PROFILING(settings.kernel_profile);
+  double *field_data[NUM_FIELDS], *buffer_data[NUM_FACES];
+  for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+    field_data[ff] = fields[ff] ? fields[ff]->data() : nullptr;
+  }
+  for (int face = 0; face < NUM_FACES; ++face) {
+    buffer_data[face] = buffers[face] ? buffers[face]->data() : nullptr;
+  }
+  const int x = chunk->x;
+  const HaloStrips strips =
+      halo_strips(chunk->x, chunk->y, depth, settings.halo_depth, pack, field_data, buffer_data, {0, chunk->y}, {0, chunk->x});
+  Kokkos::parallel_for(
+      strips.cells, KOKKOS_LAMBDA(const int index) {
+        int ss = 0;
+        while (index >= strips.strip[ss].last) {
+          ++ss;
+        }
+        const HaloStrip &s = strips.strip[ss];
+        const int cell = index - s.first;
+        const int field_index = s.field_start + (cell / s.cols) * x + cell % s.cols;
+        if (pack) s.buffer[s.buffer_start + cell] = s.field[field_index];
+        else
+          s.field[field_index] = s.buffer[s.buffer_start + cell];
+      });
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
 void run_send_recv_halo(Chunk *chunk, Settings &settings,                                                       //
                         FieldBufferType src_send_buffer, FieldBufferType src_recv_buffer,                       //
                         StagingBufferType dest_staging_send_buffer, StagingBufferType dest_staging_recv_buffer, //
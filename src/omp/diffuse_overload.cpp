@@ -52,7 +52,7 @@ bool diffuse_overload(Chunk *chunks, Settings &settings) {
               top_recv[ : tb_len], bottom_send[ : tb_len], bottom_recv[ : tb_len])
 
   double wallclock_prev = 0.0;
-  for (int tt = 0; tt < settings.end_step; ++tt) {
+  for (int tt = 0; tt < settings.end_step && settings.sim_time < settings.end_time; ++tt) {
     solve(chunks, settings, tt, &wallclock_prev);
   }
 
@@ -60,6 +60,8 @@ bool diffuse_overload(Chunk *chunks, Settings &settings) {
 
   settings.is_offload = false;
 
+  print_and_log(settings, "\n Simulated %d steps to time %.6e, stopped by %s\n", settings.sim_steps, settings.sim_time,
+                settings.sim_time < settings.end_time ? "end_step" : "end_time");
   return field_summary_driver(chunks, settings, true);
 }
 
@@ -1,4 +1,6 @@
+#include "chunk_state.h"
 #include "kernel_interface.h"
+#include <cstring>
 #include <omp.h>
 
 // Allocates, and zeroes and individual buffer
@@ -41,31 +43,23 @@ void run_set_chunk_data(Chunk *chunk, Settings &settings) {
 
 void run_set_chunk_state(Chunk *chunk, Settings &settings, State *states) {
   // Set the initial state
-  for (int ii = 0; ii != chunk->x * chunk->y; ++ii) {
+#pragma omp parallel for
+  for (int ii = 0; ii < chunk->x * chunk->y; ++ii) {
     chunk->energy0[ii] = states[0].energy;
     chunk->density[ii] = states[0].density;
   }
-  // Apply all of the states in turn
+  // Apply all of the states in turn, each only over the rows and columns it may cover
+  StateMesh mesh{chunk->x, chunk->y, chunk->vertex_x, chunk->vertex_y, chunk->cell_x, chunk->cell_y};
   for (int ss = 1; ss < settings.num_states; ++ss) {
-    for (int jj = 0; jj < chunk->y; ++jj) {
-      for (int kk = 0; kk < chunk->x; ++kk) {
-        int applyState = 0;
-
-        if (states[ss].geometry == Geometry::RECTANGULAR) {
-          applyState = (chunk->vertex_x[kk + 1] >= states[ss].x_min && chunk->vertex_x[kk] < states[ss].x_max &&
-                        chunk->vertex_y[jj + 1] >= states[ss].y_min && chunk->vertex_y[jj] < states[ss].y_max);
-        } else if (states[ss].geometry == Geometry::CIRCULAR) {
-          double radius = std::sqrt((chunk->cell_x[kk] - states[ss].x_min) * (chunk->cell_x[kk] - states[ss].x_min) +
-                                    (chunk->cell_y[jj] - states[ss].y_min) * (chunk->cell_y[jj] - states[ss].y_min));
-
-          applyState = (radius <= states[ss].radius);
-        } else if (states[ss].geometry == Geometry::POINT) {
-          applyState = (chunk->vertex_x[kk] == states[ss].x_min && chunk->vertex_y[jj] == states[ss].y_min);
-        }
-
-        // Check if state applies at this vertex, and apply
-        if (applyState) {
-          const int index1 = kk + jj * chunk->x;
+    StateCells cells = state_cells(states[ss], mesh);
+#pragma omp parallel for
+    for (int jj = cells.first_row; jj < cells.last_row; ++jj) {
+      for (int kk = cells.first_col; kk < cells.last_col; ++kk) {
+        const int index1 = kk + jj * chunk->x;
+        if (settings.volume_fraction_samples > 1) {
+          mix_state(states[ss], state_fraction(states[ss], mesh, jj, kk, settings.volume_fraction_samples), &chunk->density[index1],
+                    &chunk->energy0[index1]);
+        } else if (state_covers(states[ss], mesh, jj, kk)) {
           chunk->energy0[index1] = states[ss].energy;
           chunk->density[index1] = states[ss].density;
         }
@@ -74,8 +68,9 @@ void run_set_chunk_state(Chunk *chunk, Settings &settings, State *states) {
   }
 
   // Set an initial state for u
-  for (int jj = 1; jj != chunk->y - 1; ++jj) {
-    for (int kk = 1; kk != chunk->x - 1; ++kk) {
+#pragma omp parallel for
+  for (int jj = 1; jj < chunk->y - 1; ++jj) {
+    for (int kk = 1; kk < chunk->x - 1; ++kk) {
       const int index1 = kk + jj * chunk->x;
       chunk->u[index1] = chunk->energy0[index1] * chunk->density[index1];
     }
@@ -193,3 +188,20 @@ void run_kernel_finalise(Chunk *chunk, Settings &) {
   std::free(chunk->bottom_send);
   std::free(chunk->bottom_recv);
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  int len = chunk->x * chunk->y;
+#ifdef OMP_TARGET
+  #pragma omp target update from(field[ : len])
+#endif
+  std::memcpy(host, field, sizeof(double) * len);
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  int len = chunk->x * chunk->y;
+  std::memcpy(field, host, sizeof(double) * len);
+#ifdef OMP_TARGET
+  #pragma omp target update to(field[ : len])
+#endif
+}
@@ -1,5 +1,6 @@
 #include "chunk.h"
 #include "comms.h"
+#include "halo_strips.h"
 #include "shared.h"
 
 // Packs left data into buffer.
@@ -176,6 +177,65 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+// Packs or unpacks every strip in one parallel region, each worksharing loop left without a barrier as strips never overlap
+static void pack_or_unpack_strips(const int x, const HaloStrips &strips, bool pack, bool is_offload) {
+#ifdef OMP_TARGET
+  // The strips carry device addresses, as the pointers inside them are not translated when mapped
+  HaloStrips device_strips = strips;
+  for (int ss = 0; ss < device_strips.count; ++ss) {
+    double *field = device_strips.strip[ss].field;
+    double *buffer = device_strips.strip[ss].buffer;
+  #pragma omp target data if (is_offload) use_device_ptr(field, buffer)
+    {
+      device_strips.strip[ss].field = field;
+      device_strips.strip[ss].buffer = buffer;
+    }
+  }
+
+  const HaloStrip *strip = device_strips.strip;
+  const int count = device_strips.count;
+  const int cells = device_strips.cells;
+  #pragma omp target teams distribute parallel for if (is_offload) map(to : strip[ : count])
+  for (int ii = 0; ii < cells; ++ii) {
+    int ss = 0;
+    while (ii >= strip[ss].last) {
+      ++ss;
+    }
+    const int cell = ii - strip[ss].first;
+    const int index = strip[ss].field_start + (cell / strip[ss].cols) * x + cell % strip[ss].cols;
+    if (pack) strip[ss].buffer[strip[ss].buffer_start + cell] = strip[ss].field[index];
+    else
+      strip[ss].field[index] = strip[ss].buffer[strip[ss].buffer_start + cell];
+  }
+#else
+  #pragma omp parallel
+  for (int ss = 0; ss < strips.count; ++ss) {
+    const HaloStrip &s = strips.strip[ss];
+    const int rows = (s.last - s.first) / s.cols;
+  #pragma omp for collapse(2) nowait
+    for (int jj = 0; jj < rows; ++jj) {
+      for (int kk = 0; kk < s.cols; ++kk) {
+        const int index = s.field_start + jj * x + kk;
+        if (pack) s.buffer[s.buffer_start + jj * s.cols + kk] = s.field[index];
+        else
+          s.field[index] = s.buffer[s.buffer_start + jj * s.cols + kk];
+      }
+    }
+  }
+#endif
+}
+
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  START_PROFILING(settings.kernel_profile);
+  const int x_inner = chunk->x - 2 * settings.halo_depth;
+  const int y_inner = chunk->y - 2 * settings.halo_depth;
+  HaloStrips strips = halo_strips(chunk->x, chunk->y, depth, settings.halo_depth, pack, fields, buffers, {settings.halo_depth, y_inner},
+                                  {settings.halo_depth, x_inner});
+  pack_or_unpack_strips(chunk->x, strips, pack, settings.is_offload);
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
 void run_send_recv_halo(Chunk *chunk, Settings &settings,                                 //
                         FieldBufferType src_send_buffer, FieldBufferType src_recv_buffer, //
                         StagingBufferType, StagingBufferType,                             //
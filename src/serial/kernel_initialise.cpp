@@ -1,4 +1,6 @@
+#include "chunk_state.h"
 #include "kernel_interface.h"
+#include <cstring>
 
 // Allocates, and zeroes and individual buffer
 static void allocate_buffer(double **a, int x, int y) {
@@ -51,27 +53,17 @@ void run_set_chunk_state(Chunk *chunk, Settings &settings, State *states) {
     chunk->density[ii] = states[0].density;
   }
 
-  // Apply all of the states in turn
+  // Apply all of the states in turn, each only over the rows and columns it may cover
+  StateMesh mesh{chunk->x, chunk->y, chunk->vertex_x, chunk->vertex_y, chunk->cell_x, chunk->cell_y};
   for (int ss = 1; ss < settings.num_states; ++ss) {
-    for (int jj = 0; jj < chunk->y; ++jj) {
-      for (int kk = 0; kk < chunk->x; ++kk) {
-        int applyState = 0;
-
-        if (states[ss].geometry == Geometry::RECTANGULAR) {
-          applyState = (chunk->vertex_x[kk + 1] >= states[ss].x_min && chunk->vertex_x[kk] < states[ss].x_max &&
-                        chunk->vertex_y[jj + 1] >= states[ss].y_min && chunk->vertex_y[jj] < states[ss].y_max);
-        } else if (states[ss].geometry == Geometry::CIRCULAR) {
-          double radius = sqrt((chunk->cell_x[kk] - states[ss].x_min) * (chunk->cell_x[kk] - states[ss].x_min) +
-                               (chunk->cell_y[jj] - states[ss].y_min) * (chunk->cell_y[jj] - states[ss].y_min));
-
-          applyState = (radius <= states[ss].radius);
-        } else if (states[ss].geometry == Geometry::POINT) {
-          applyState = (chunk->vertex_x[kk] == states[ss].x_min && chunk->vertex_y[jj] == states[ss].y_min);
-        }
-
-        // Check if state applies at this vertex, and apply
-        if (applyState) {
-          const int index1 = kk + jj * chunk->x;
+    StateCells cells = state_cells(states[ss], mesh);
+    for (int jj = cells.first_row; jj < cells.last_row; ++jj) {
+      for (int kk = cells.first_col; kk < cells.last_col; ++kk) {
+        const int index1 = kk + jj * chunk->x;
+        if (settings.volume_fraction_samples > 1) {
+          mix_state(states[ss], state_fraction(states[ss], mesh, jj, kk, settings.volume_fraction_samples), &chunk->density[index1],
+                    &chunk->energy0[index1]);
+        } else if (state_covers(states[ss], mesh, jj, kk)) {
           chunk->energy0[index1] = states[ss].energy;
           chunk->density[index1] = states[ss].density;
         }
@@ -176,3 +168,12 @@ void run_kernel_finalise(Chunk *chunk, Settings &settings) {
   std::free(chunk->bottom_send);
   std::free(chunk->bottom_recv);
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  std::memcpy(host, field, sizeof(double) * chunk->x * chunk->y);
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  std::memcpy(field, host, sizeof(double) * chunk->x * chunk->y);
+}
@@ -1,5 +1,6 @@
 #include "chunk.h"
 #include "comms.h"
+#include "halo_strips.h"
 #include "shared.h"
 
 // Packs left data into buffer.
@@ -124,6 +125,25 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  START_PROFILING(settings.kernel_profile);
+  const int x_inner = chunk->x - 2 * settings.halo_depth;
+  const int y_inner = chunk->y - 2 * settings.halo_depth;
+  HaloStrips strips = halo_strips(chunk->x, chunk->y, depth, settings.halo_depth, pack, fields, buffers, {settings.halo_depth, y_inner},
+                                  {settings.halo_depth, x_inner});
+  for (int ss = 0; ss < strips.count; ++ss) {
+    const HaloStrip &s = strips.strip[ss];
+    for (int ii = 0; ii < s.last - s.first; ++ii) {
+      const int index = s.field_start + (ii / s.cols) * chunk->x + ii % s.cols;
+      if (pack) s.buffer[s.buffer_start + ii] = s.field[index];
+      else
+        s.field[index] = s.buffer[s.buffer_start + ii];
+    }
+  }
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
 void run_send_recv_halo(Chunk *, Settings &settings, FieldBufferType send_buffer, FieldBufferType recv_buffer, StagingBufferType,
                         StagingBufferType, int buffer_len, int neighbour, int send_tag, int recv_tag) {
   send_recv_message(settings, send_buffer, recv_buffer, buffer_len, neighbour, send_tag, recv_tag);
@@ -1,6 +1,7 @@
 #include "dpl_shim.h"
 #include "kernel_interface.h"
 #include "ranged.h"
+#include <cstring>
 
 // Initialisation kernels
 void run_set_chunk_data(Chunk *chunk, Settings &settings) {
@@ -191,3 +192,12 @@ void run_kernel_finalise(Chunk *chunk, Settings &) {
   dealloc_raw(chunk->bottom_send);
   dealloc_raw(chunk->bottom_recv);
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  std::memcpy(host, field, sizeof(double) * chunk->x * chunk->y);
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  std::memcpy(field, host, sizeof(double) * chunk->x * chunk->y);
+}
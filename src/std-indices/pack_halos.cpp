@@ -1,5 +1,6 @@
 #include "chunk.h"
 #include "comms.h"
+#include "halo_strips.h"
 #include "dpl_shim.h"
 #include "ranged.h"
 #include "shared.h"
@@ -111,6 +112,29 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+// Packs or unpacks every exchanged field on every face with a buffer in one pass over their cells
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  START_PROFILING(settings.kernel_profile);
+  const int x = chunk->x;
+  const HaloStrips strips =
+      halo_strips(chunk->x, chunk->y, depth, settings.halo_depth, pack, fields, buffers, {0, chunk->y}, {0, chunk->x});
+  ranged<int> it(0, strips.cells);
+  std::for_each(EXEC_POLICY, it.begin(), it.end(), [=](const int index) {
+    int ss = 0;
+    while (index >= strips.strip[ss].last) {
+      ++ss;
+    }
+    const HaloStrip &s = strips.strip[ss];
+    const int cell = index - s.first;
+    const int field_index = s.field_start + (cell / s.cols) * x + cell % s.cols;
+    if (pack) s.buffer[s.buffer_start + cell] = s.field[field_index];
+    else
+      s.field[field_index] = s.buffer[s.buffer_start + cell];
+  });
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
 void run_send_recv_halo(Chunk *, Settings &settings, FieldBufferType src_send_buffer, FieldBufferType src_recv_buffer, StagingBufferType,
                         StagingBufferType, int buffer_len, int neighbour, int send_tag, int recv_tag) {
   // Host/USM model, no-op for staging buffers here
@@ -2,6 +2,7 @@
 #include "settings.h"
 #include "shared.h"
 #include "sycl_shared.hpp"
+#include <algorithm>
 
 using namespace cl::sycl;
 
@@ -325,3 +326,14 @@ void run_kernel_finalise(Chunk *chunk, Settings &) {
 
   delete chunk->ext->device_queue;
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  auto source = field->get_host_access(sycl::read_only);
+  std::copy(&source[0], &source[0] + chunk->x * chunk->y, host);
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  auto dest = field->get_host_access(sycl::write_only);
+  std::copy(host, host + chunk->x * chunk->y, &dest[0]);
+}
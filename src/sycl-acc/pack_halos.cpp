@@ -206,6 +206,20 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+// Fields are reached through accessors, so each strip stays a submission of its own, none of them waited on
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  for (int face = 0; face < NUM_FACES; ++face) {
+    if (!buffers[face]) continue;
+    int offset = 0;
+    for (int ff = 0; ff < NUM_FIELDS; ++ff) {
+      if (!fields[ff]) continue;
+      run_pack_or_unpack(chunk, settings, depth, face, pack, fields[ff], buffers[face], offset);
+      offset += depth * (face == CHUNK_LEFT || face == CHUNK_RIGHT ? chunk->y : chunk->x);
+    }
+  }
+}
+
 #if !(defined(__HIPSYCL__) || defined(__OPENSYCL__))
 
 template <typename A> decltype(auto) get_native_ptr_or_throw(sycl::interop_handle &ih, A accessor) {
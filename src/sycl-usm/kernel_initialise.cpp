@@ -326,3 +326,12 @@ void run_kernel_finalise(Chunk *chunk, Settings &) {
 
   delete chunk->ext->device_queue;
 }
+
+// Copies the cells of a field, halos included, to and from host memory
+void run_field_to_host(Chunk *chunk, Settings &, FieldBufferType field, double *host) {
+  chunk->ext->device_queue->copy(field, host, chunk->x * chunk->y).wait_and_throw();
+}
+
+void run_field_from_host(Chunk *chunk, Settings &, const double *host, FieldBufferType field) {
+  chunk->ext->device_queue->copy(host, field, chunk->x * chunk->y).wait_and_throw();
+}
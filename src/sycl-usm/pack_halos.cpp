@@ -1,5 +1,6 @@
 #include "chunk.h"
 #include "comms.h"
+#include "halo_strips.h"
 #include "shared.h"
 #include "sycl_shared.hpp"
 
@@ -182,6 +183,34 @@ void run_pack_or_unpack(Chunk *chunk, Settings &settings, int depth, int face, b
   STOP_PROFILING(settings.kernel_profile, __func__);
 }
 
+void run_pack_or_unpack_faces(Chunk *chunk, Settings &settings, int depth, bool pack, const FieldBufferType fields[NUM_FIELDS],
+                              const FieldBufferType buffers[NUM_FACES]) {
+  START_PROFILING(settings.kernel_profile);
+  const int x = chunk->x;
+  const HaloStrips strips =
+      halo_strips(chunk->x, chunk->y, depth, settings.halo_depth, pack, fields, buffers, {0, chunk->y}, {0, chunk->x});
+  if (strips.cells > 0) {
+    chunk->ext->device_queue
+        ->submit([&](handler &h) {
+          h.parallel_for<class pack_or_unpack_strips>(range<1>(strips.cells), [=](id<1> idx) {
+            const int index = idx[0];
+            int ss = 0;
+            while (index >= strips.strip[ss].last) {
+              ++ss;
+            }
+            const HaloStrip &s = strips.strip[ss];
+            const int cell = index - s.first;
+            const int field_index = s.field_start + (cell / s.cols) * x + cell % s.cols;
+            if (pack) s.buffer[s.buffer_start + cell] = s.field[field_index];
+            else
+              s.field[field_index] = s.buffer[s.buffer_start + cell];
+          });
+        })
+        .wait_and_throw();
+  }
+  STOP_PROFILING(settings.kernel_profile, __func__);
+}
+
 void run_send_recv_halo(Chunk *chunk, Settings &settings,                                 //
                         FieldBufferType src_send_buffer, FieldBufferType src_recv_buffer, //
                         StagingBufferType, StagingBufferType,                             //